@@ -1,4 +1,6 @@
+#pragma once
 #include <string>
+#include <cstdint>
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
@@ -12,6 +14,7 @@
 #include <atomic>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
 // #include <chrono>   
 // using namespace chrono;
 using namespace std;
@@ -20,6 +23,46 @@ using namespace std;
 
 #define POOL_CHUNK_SIZE 10000  // 设置 pthread pool 方法中一个任务处理的元素量
 
+#define PROB_LOG_EXACT 0  // 子 PT 概率的增量计算方式，0: float 乘除，1: log 空间精确计算
+
+#define MAX_BATCH_GUESSES 1000000  // 单次 PopNext 最多展开的猜测数，超过时 PT 分多次展开
+
+// 块展开：最后一个 segment 很小时，倒数第二个 segment 的后续 value 类一起展开（默认关闭）
+// 开启后出队顺序不再严格按概率降序：块内后续类的猜测随当前类提前输出（概率最多低到 BLOCK_PROB_RATIO 倍），
+// 各生成方法的输出随之改变，猜测集合不变
+#define BLOCK_EXPANSION 0
+#define BLOCK_MIN_BATCH 10000   // 一个 PT 展开的猜测数低于该值时尝试块展开
+#define BLOCK_PROB_RATIO 0.5f   // 块内 value 类的概率不低于 PT 当前类概率的该比例，限制块展开对概率顺序的影响
+
+#define ADAPTIVE_BUCKETS 48     // 自适应生成方法按单次展开猜测数的 log2 分桶统计吞吐量
+
+#define DIST_STEP_GUESSES 100000    // 分布式队列：每一步本进程最多生成的猜测数，每步结束时交换一次水位线
+#define DIST_WATERMARK_RATIO 0.9f   // 分布式队列：每一步只展开概率不低于“全局水位线 * 该比例”的 PT
+
+#define THRESHOLD_SLICE_GUESSES 100000   // 概率阈值枚举：大的 PT 按该猜测数切片，各线程动态领取
+#define THRESHOLD_STEP_GUESSES 1000000   // 概率阈值枚举：主循环每一步最多生成的猜测数
+
+#define MW_TASK_GUESSES 100000      // 主从调度：一个任务的目标猜测数，小 PT 合并到同一个任务中
+#define MW_MIN_TASK_GUESSES 10000   // 主从调度：大 PT 切分时每一片的最小猜测数
+#define MW_TAG_REQUEST 101          // 主从调度：工作进程请求任务的消息标签
+#define MW_TAG_TASK 102             // 主从调度：主进程下发任务的消息标签（长度为 0 表示结束）
+
+class CommThread;   // 通信线程，见 comm.h
+
+// 生成方法编号，即 gen_backends 注册表中的下标
+enum GenBackend
+{
+    GEN_SERIAL = 0,     // 串行
+    GEN_PTHREAD,        // pthread（无线程池）
+    GEN_PTHREAD_POOL,   // pthread（有线程池）
+    GEN_OPENMP,         // OpenMP
+    GEN_MPI,            // MPI
+    GEN_MPI_OPENMP,     // MPI + OpenMP
+    GEN_ADAPTIVE,       // 自适应：按 PT 规模在串行 / OpenMP / 线程池之间选择
+    GEN_OPENMP_PERSISTENT,  // OpenMP（常驻并行区域，见 PopBatch；单个 PT 的展开与 openmp 相同）
+    GEN_BACKEND_NUM
+};
+
 class segment
 {
 public:
@@ -43,12 +86,42 @@ public:
     // total_freq作为分母，用于计算每个value的概率
     int total_freq = 0;
 
+    // 按照概率降序排列的概率，即 ordered_freqs[i] / total_freq，在 order() 中一次性预计算
+    // PT 的子节点只改变一个下标，其概率可以由父节点概率乘以新旧两个 value 的概率之比得到
+    vector<float> ordered_probs;
+
+    // 与 ordered_probs 对应的对数概率，用于 log 空间下的精确增量计算
+    vector<double> ordered_log_probs;
+
+    // 等频 value 类：ordered_values 中频数相同的一段连续 value 归为一类
+    // 第 c 类包含的 value 下标为 [class_starts[c], class_starts[c+1])，末尾额外存放 value 总数作为哨兵
+    // PT 在非最后一个 segment 上按类推进，一个类中的所有 value 概率相同，会在同一次展开中一起生成
+    vector<int> class_starts;
+
+    // 每个类中单个 value 的概率及其对数
+    vector<float> class_probs;
+    vector<double> class_log_probs;
+
+    // value 类的数目
+    int ClassCount() const { return class_starts.size() - 1; }
+
     // 未排序的value，其中int就是对应的id
     unordered_map<string, int> values;
 
     // 根据id，在freqs中查找/修改一个value的频数
     unordered_map<int, int> freqs;
 
+    // 生成时使用的 value 表：value 按概率降序紧密存放在模型镜像中（见 model::Pack），
+    // 第 i 个 value 为 value_bytes[value_offsets[i], value_offsets[i+1])。
+    // 由 model::Attach 指向模型镜像，多进程时镜像位于节点内共享的 MPI 窗口中，同一节点的进程共用一份
+    int value_count = 0;
+    const char *value_bytes = NULL;
+    const uint32_t *value_offsets = NULL;
+
+    int ValueCount() const { return value_count; }
+    const char *ValueData(int i) const { return value_bytes + value_offsets[i]; }
+    int ValueLength(int i) const { return value_offsets[i + 1] - value_offsets[i]; }
+
 
     void insert(string value);
     void order();
@@ -66,17 +139,40 @@ public:
     void insert(segment seg);
     void PrintPT();
 
+    // PT 的结构字符串，例如 "L6D1"
+    string Pattern() const;
+
     // 导出新的PT
     vector<PT> NewPTs();
 
-    // 记录当前每个segment（除了最后一个）对应的value，在模型中的下标
+    // 记录当前每个segment（除了最后一个）对应的value类，在模型中的下标
     vector<int> curr_indices;
 
-    // 记录当前每个segment（除了最后一个）对应的value，在模型中的最大下标（即最大可以是max_indices[x]-1）
+    // 记录当前每个segment（除了最后一个）对应的value类，在模型中的最大下标（即最大可以是max_indices[x]-1）
+    // 最后一个segment不按类推进，其max_indices为该segment的value总数
     vector<int> max_indices;
+
+    // 该 PT 已经展开（生成）的猜测数。PT 的猜测数超过 MAX_BATCH_GUESSES 时分多次展开，
+    // 未展开完之前 PT 留在队首（剩余猜测的概率与其相同，顺序不受影响）
+    long long gen_offset = 0;
+
+    // 该 PT 所在子树的根（初始 PT）在 model::ordered_pts 中的下标，在 init 时确定，子 PT 继承
+    // 主从调度时工作进程据此找到 PT 的结构（content / seg_ids / max_indices），任务中只需传递各下标
+    int root = 0;
+
+    // 块展开时，倒数第二个 segment 一次覆盖的 value 类数目（从 curr_indices 对应的类开始）
+    // 由 PlanBlock 在 PT 出队时确定，NewPTs 在该 segment 上直接跳过整个块，保证每个猜测只生成一次
+    int block_len = 1;
+    // 记录每个segment在模型中（letters/digits/symbols）的下标，在 init 时确定
+    // 这样计算概率、生成猜测时可以直接定位，而不需要反复调用 FindLetter 等线性查找
+    vector<int> seg_ids;
+
     // void init();
     float preterm_prob;
     float prob;
+
+    // prob 的对数形式，子 PT 的概率在 log 空间中增量更新
+    double log_prob;
 };
 
 class model
@@ -123,6 +219,9 @@ public:
     int FindDigit(segment seg);
     int FindSymbol(segment seg);
 
+    // 根据 pt.seg_ids 直接取得 PT 中第 index 个 segment 在模型中的统计数据
+    segment &GetSegment(const PT &pt, int index);
+
     unordered_map<int, int> preterm_freq;
     unordered_map<int, int> letters_freq;
     unordered_map<int, int> digits_freq;
@@ -146,6 +245,62 @@ public:
 
     // 打印模型
     void print();
+
+    // 将生成所需的数据（各 segment 的 value 表和 value 类、PT 表）序列化为一个连续的模型镜像
+    void Pack(vector<char> &image) const;
+
+    // 使模型指向一个模型镜像：各 segment 的 value 表直接指向镜像，value 类和 PT 表按镜像重建（模型为空时新建）
+    // 镜像不完整或已损坏时返回 false
+    bool Attach(const char *image, size_t size);
+
+    // 将当前使用的模型镜像写入文件（检查点恢复时不必重新训练）
+    bool SaveImage(string path) const;
+
+    // 从文件读入模型镜像并 Attach（代替训练），文件不存在、不完整或已损坏时返回 false
+    bool LoadImage(string path);
+
+    // 释放只在训练中使用的数据（未排序的 value、频数表、ordered_values 等），生成只需要镜像
+    void ReleaseTrainingData();
+
+    // 节点内共享模型：每个节点只由一个进程训练，模型镜像放在 MPI_Win_allocate_shared 分配的窗口中，
+    // 同一节点的所有进程 Attach 到这份镜像，不再各自保存 value 表（集合操作，所有进程都要调用）
+    void TrainShared(string train_path);
+
+    // 释放共享窗口（集合操作，MPI_Finalize 之前调用）
+    void ReleaseShared();
+
+    // order() 生成的本地镜像；共享之后改用窗口中的镜像，本地镜像释放
+    vector<char> image;
+    MPI_Win shared_win = MPI_WIN_NULL;
+
+    // 当前 Attach 的镜像（本地镜像或共享窗口）
+    const char *attached = NULL;
+    size_t attached_size = 0;
+};
+
+// 一次生成任务：PT 本次展开的猜测区间 [begin, end)
+// PT 的全部猜测按 "前缀 × 最后一个 segment 的所有 value" 排布，第 g 个猜测为
+// prefixes[g / width - row_begin] + last 的第 g % width 个 value
+struct GuessJob
+{
+    vector<string> prefixes;    // 区间覆盖到的前缀，prefixes[0] 对应第 row_begin 行
+    long long row_begin;
+    segment *last;              // 最后一个 segment 在模型中的统计数据
+    long long width;            // 最后一个 segment 的 value 数，即每个前缀对应的猜测数
+    long long begin, end;       // 本次生成的猜测区间（以 PT 内的猜测序号计）
+};
+
+// 将 job 中 [start, end) 区间的猜测依次写入 out
+void FillGuesses(const GuessJob &job, long long start, long long end, string *out);
+
+// 猜测来源记录：guesses 中从 first 开始的一段猜测由同一个 PT 的一次展开生成
+// 命中目标哈希时，据此报告命中的口令来自哪个 PT（结构及各 segment 当时的 value 类下标）
+struct GuessSpan
+{
+    size_t first;               // 这一段第一个猜测在 guesses 中的下标
+    string pattern;             // PT 的结构，例如 "L6D1"
+    vector<int> curr_indices;   // 展开时 PT 各 segment 的下标
+    long long gen_offset;       // 展开时 PT 已生成的猜测数（分多次展开的 PT 才会非 0）
 };
 
 // 优先队列，用于按照概率降序生成口令猜测
@@ -162,6 +317,24 @@ public:
     // 计算一个pt的概率
     void CalProb(PT &pt);
 
+    // 由父 PT 的概率增量计算子 PT 的概率（子 PT 与父 PT 仅在 pivot 处的下标不同）
+    void CalChildProb(const PT &parent, PT &child);
+
+    // 一个 PT 展开后的猜测总数（各前缀 segment 当前类的大小之积 × 最后一个 segment 的 value 数）
+    long long GuessCount(const PT &pt);
+
+    // 生成前缀：行号 [row_begin, row_end) 对应的各前缀 segment 类内 value 的组合
+    void BuildPrefixes(const PT &pt, long long row_begin, long long row_end, vector<string> &prefixes);
+
+    // 为 PT 本次展开（从 gen_offset 起，至多 MAX_BATCH_GUESSES 个猜测）准备生成任务
+    void PrepareJob(const PT &pt, GuessJob &job);
+
+    // 为 PT 的猜测区间 [begin, end) 准备生成任务（只生成区间覆盖到的前缀）
+    void PrepareRange(const PT &pt, long long begin, long long end, GuessJob &job);
+
+    // 块展开：为即将出队的 PT 确定倒数第二个 segment 的块大小 block_len
+    void PlanBlock(PT &pt);
+
     // 优先队列的初始化
     void init();
 
@@ -177,32 +350,154 @@ public:
     // openmp 生成
     void OpenMPGenerate(PT pt);
 
+    // openmp 生成（常驻并行区域，连续处理多个 PT，直到生成至少 target 个猜测）
+    void OpenMPPersistentGenerate(long long target);
+
     // mpi 生成
     void MPIGenerate(PT pt);
     
     // mpi + openmp
     void MPIplusOpenMPGenerate(PT pt);
 
+    // 按概率将新的 PT 插入优先队列
+    void InsertPT(const PT &pt);
+
+    // 当前使用的生成方法（GenBackend），可以在运行时通过 SetBackend 按名称切换
+    int backend = GEN_MPI_OPENMP;
+
+    // 按名称选择生成方法，名称见 gen_backends，未知名称返回 false
+    bool SetBackend(const string &name);
+
+    // 自适应生成：根据本次展开的猜测数和各方法的实测吞吐量选择生成方法
+    void AdaptiveGenerate(PT pt);
+
+    // 在本机上标定各生成方法：OpenMP 线程数、线程池线程数和任务粒度、各规模下吞吐量最高的方法
+    void CalibrateBackends();
+
+    // 可标定的运行参数，初值与原先的宏定义相同
+    int gen_threads = NUM_THREADS;                  // OpenMP 方法使用的线程数
+    int pool_threads = NUM_THREADS;                 // 线程池的线程数（标定时按此重建线程池）
+    long long pool_chunk_size = POOL_CHUNK_SIZE;    // 线程池中一个任务处理的猜测数
+    long long pool_serial_threshold = 100000;       // 猜测数低于该值时，线程池方法直接串行处理
+
+    // 自适应策略的吞吐量表（猜测/秒）：adaptive_rate[桶][方法]，0 表示尚未测量
+    double adaptive_rate[ADAPTIVE_BUCKETS][GEN_BACKEND_NUM] = {};
+
     // 将优先队列最前面的一个 PT
     void PopNext();
+
+    // 展开一批 PT：openmp_persistent 在常驻并行区域中连续处理多个 PT，直到生成至少 target 个猜测，其余方法展开一个 PT
+    void PopBatch(long long target);
+
+    // 队首 PT 本次展开后的善后：推进 gen_offset，展开完毕时生成子 PT 并出队
+    void FinishFront();
     
     // mpi 并行化的批量处理 PT
     void MPIPopNext();
 
-    int total_guesses = 0;
+    // 分布式队列：init 之后调用，只保留本进程负责的初始 PT（按概率顺序轮流分配给各进程）
+    // 子 PT 只由父 PT 在 pivot 之后的位置推进得到，每个 PT 恰好属于一棵以初始 PT 为根的子树，
+    // 因此各进程的队列互不相交，合起来恰好覆盖整个 PT 空间
+    void PartitionRoots(int rank, int size);
+
+    // 本地队首的概率（队列为空时为 0），各进程取最大值即为全局水位线
+    float FrontProb() const;
+
+    // 分布式队列的一步：依次展开概率不低于 floor 的 PT，直到本地生成 budget 个猜测；返回本步生成的猜测数
+    long long DistributedStep(float floor, long long budget);
+
+    // 主从调度（主进程）：响应工作进程的请求，按概率顺序下发任务，下发的猜测数超过 limit 或队列为空后
+    // 给每个工作进程发送结束消息，所有工作进程都结束后返回。返回下发的猜测总数
+    long long MasterSchedule(long long limit);
+
+    // 主从调度（工作进程）：取得一个任务并生成其中的猜测（追加到 guesses），收到结束消息时返回 false
+    // 取得任务后先请求下一个任务再生成，主进程的回复在生成期间到达
+    // 有通信线程时，下一个任务的请求和接收都交给通信线程，生成期间即完成接收
+    bool WorkerFetch();
+
+    // 主从调度使用的通信线程（为 NULL 时在 MPI_COMM_WORLD 上由调用线程通信）
+    // 主进程和工作进程都使用它的通信子，需在 MasterSchedule / WorkerFetch 之前设置
+    CommThread *comm_thread = NULL;
+
+    // 概率阈值枚举（不使用优先队列）：init 之后调用，对每个初始 PT 在有序的 value 类表上做深度优先搜索，
+    // 按累积概率剪枝，找出概率不低于 floor 的全部 PT（即队列在队首概率降到 floor 以下之前会展开的 PT，不做块展开）；
+    // 各初始 PT 的搜索互不相关，由 OpenMP 线程并行完成。多进程时找到的 PT 轮流分给各进程
+    void ThresholdPlan(float floor, int rank, int size);
+
+    // 概率阈值枚举的一步：生成接下来至多 budget 个猜测（追加到 guesses），各线程动态领取 PT 切片并行填充，
+    // 不经过共享队列，也没有锁。猜测不按概率排序。返回本步生成的猜测数
+    long long ThresholdGenerate(long long budget);
+
+    // 概率阈值枚举：本进程的 PT 是否已经全部生成
+    bool ThresholdDone() const;
+
+    // 概率阈值枚举：本进程负责的 PT 数和猜测总数
+    size_t ThresholdUnits() const;
+    long long ThresholdGuesses();
+
+    // 记录 PT 出队展开前 guesses 的位置，使每个猜测都能追溯到生成它的 PT
+    void RecordSpan(const PT &pt);
+
+    // 查找 guesses[index] 所属的来源记录
+    const GuessSpan *FindSpan(size_t index) const;
+
+    // 清空已生成的猜测及其来源记录
+    void ClearGuesses();
+
+    // 只保留前 n 个已生成的猜测（按猜测区间截断输出时使用）
+    void TruncateGuesses(size_t n);
+
+    // 快进：跳过接下来的 n 个猜测而不生成（只由 GuessCount 计数），返回实际跳过的猜测数
+    // 之后生成的猜测与不跳过时第 n 个之后的猜测完全相同，用于多台机器各自枚举同一次运行的不同区间
+    long long SkipGuesses(long long n);
+
+    // 当前生成方法是否在各进程之间划分猜测（MPI 方法）
+    bool Partitioned() const;
+
+    // 检查点：将队列的全部内容（枚举的前沿）编码为紧凑的字节序列，每个 PT 只记录根、各下标、展开进度和概率
+    void SaveState(vector<char> &state) const;
+
+    // 从检查点恢复队列（init 之后、PartitionRoots 之前调用），编码与模型不符时返回 false
+    bool LoadState(const char *state, size_t size);
+
+    // 上次 ClearGuesses 以来生成的猜测数。MPI 方法下为所有进程的合计（由确定的划分直接算出），其余方法为本进程的猜测数
+    long long total_guesses = 0;
     vector<string> guesses;
+    vector<GuessSpan> spans;
+
+private:
+    // 主从调度（主进程）：组装一个任务，返回任务中的猜测数
+    long long BuildTask(vector<long long> &task, int workers);
+
+    long long mw_cursor = -1;       // 主进程：队首 PT 本次展开中下一个待下发的猜测序号，-1 表示尚未开始
+    bool mw_requested = false;      // 工作进程：是否已经请求了下一个任务
+    vector<PT> mw_roots;            // 工作进程：各初始 PT，按 root 下标存放
+    vector<long long> mw_next;      // 工作进程：通信线程接收的下一个任务
+
+    // 概率阈值枚举：深度优先搜索，为 pt 的第 pos 个 segment 选择 value 类；bound[k] 为第 k 个及之后的 segment 能取到的最大概率之积
+    void ThresholdSearch(PT &pt, int pos, float prob, float floor, const vector<float> &bound, vector<PT> &found);
+
+    vector<PT> th_units;            // 概率阈值枚举：本进程负责的 PT
+    size_t th_cursor = 0;           // 概率阈值枚举：下一个待生成的 PT
+    long long th_offset = 0;        // 概率阈值枚举：该 PT 中下一个待生成的猜测序号
 };
 
+// 生成方法注册表：名称 -> 生成函数，PopNext 通过 backend 在表中查找要调用的方法
+typedef void (PriorityQueue::*GenerateFunc)(PT pt);
+typedef struct {
+    const char* name;           // 运行时选择时使用的名称
+    GenerateFunc func;          // 对应的生成函数
+} genBackend_t;
+extern const genBackend_t gen_backends[GEN_BACKEND_NUM];
+
 // [========== pthread 方法相关 ==========] //
 
 // 线程数据结构
 typedef struct {
     int t_id;                   // 线程 id
-    segment* a;                 // segment 指针，取表中值生成猜测需调用
-    int max_index;              // 该 segment 的取值总数，即表值最大索引
+    GuessJob* job;              // 生成任务，线程按 t_id 划分其中的猜测区间
     vector<string>* guesses;    // 指向所有生成的猜测
-    int* total_guesses;         // 指向生成猜测总量
-    string init_guess;          // 猜测前缀，多 segment 的猜测时需调用
+    long long* total_guesses;   // 指向生成猜测总量
 } threadParam_t;
 
 // 线程函数
@@ -210,10 +505,9 @@ void* threadFunc(void* param);
 
 // 线程任务结构
 typedef struct {
-    int t_start, t_end;         // 该任务生成猜测的起点和终点
-    string t_preguess;          // 猜测前缀
-    vector<string>* shared_values;  // 指向 segment 的所有取值的向量组
-    string* shared_guesses;     // 指向总任务的猜测结果，所有线程共享一个字符串组
+    long long t_start, t_end;   // 该任务生成猜测的起点和终点（以 job 内的猜测序号计）
+    GuessJob* job;              // 所属的生成任务
+    string* shared_guesses;     // 指向总任务的猜测结果，所有线程共享一个字符串组（下标从 job->begin 起算）
     bool t_active;              // 标识此任务是否是活跃状态（处于任务队列/正在被线程处理）
 } threadTask_t;
 
@@ -240,7 +534,7 @@ class ThreadPool
     
     public:
     // 构造函数
-    ThreadPool();
+    ThreadPool(int num_threads = NUM_THREADS);
     // 析构函数
     ~ThreadPool();
     
@@ -255,7 +549,7 @@ private:
 };
 
 // 创建线程池
-void initThreadPool();
+void initThreadPool(int num_threads = NUM_THREADS);
 
 // 删除线程池
 void deleteThreadPool();
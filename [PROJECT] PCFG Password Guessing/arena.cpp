@@ -0,0 +1,88 @@
+#include "arena.h"
+#include <iostream>
+#include <cstdlib>
+#include <sys/mman.h>
+
+using namespace std;
+
+Arena::~Arena()
+{
+    release();
+}
+
+/**
+ * init: 映射暂存区
+ * 先尝试预留的大页（不加 MAP_NORESERVE：预留的大页不够时 mmap 直接失败，而不是在访问时收到 SIGBUS）；
+ * 失败时改用普通匿名映射，并用 MADV_HUGEPAGE 申请透明大页
+ * 映射后不写入任何页，物理页由第一次写入的线程分配，因此位于该线程所在的 NUMA 节点
+ * @param capacity 容量（字节）
+ * @return 是否成功
+ */
+bool Arena::init(size_t capacity)
+{
+    release();
+    size = (capacity + ARENA_HUGE_PAGE - 1) / ARENA_HUGE_PAGE * ARENA_HUGE_PAGE;
+
+    void *map = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    explicit_huge = (map != MAP_FAILED);
+#endif
+    if (map == MAP_FAILED) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (map == MAP_FAILED) {
+            size = 0;
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(map, size, MADV_HUGEPAGE);
+#endif
+    }
+    base = (char *)map;
+    used = 0;
+    return true;
+}
+
+/**
+ * alloc: 从暂存区中分配
+ * @param size 字节数
+ * @param align 对齐（2 的幂）
+ * @return 起始地址
+ */
+void *Arena::alloc(size_t size, size_t align)
+{
+    size_t start = (used + align - 1) & ~(align - 1);
+    if (start + size > this->size) {
+        cerr << "Arena exhausted: " << start + size << " > " << this->size << " bytes" << endl;
+        abort();
+    }
+    used = start + size;
+    return base + start;
+}
+
+/**
+ * release: 解除映射
+ */
+void Arena::release()
+{
+    if (base != NULL) {
+        munmap(base, size);
+    }
+    base = NULL;
+    size = 0;
+    used = 0;
+    explicit_huge = false;
+}
+
+/**
+ * ThreadArena: 当前线程的 SIMD 暂存区，线程第一次调用时映射，线程结束时解除映射
+ */
+Arena &ThreadArena()
+{
+    thread_local Arena arena;
+    if (arena.capacity() == 0 && !arena.init(ARENA_THREAD_SIZE)) {
+        cerr << "Cannot map thread arena" << endl;
+        abort();
+    }
+    return arena;
+}
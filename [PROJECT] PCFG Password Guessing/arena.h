@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+
+using namespace std;
+
+// 大页大小（x86-64 / AArch64 4K 页粒度下的 2MB 大页）
+#define ARENA_HUGE_PAGE (2 << 20)
+
+// 每个线程的暂存区大小：一个大页。每次 SIMD 哈希调用用完即释放，实际只用到开头的几 KB
+// 物理页在第一次写入时才分配，按 Linux 的首次访问策略位于写入线程所在的 NUMA 节点上
+#define ARENA_THREAD_SIZE ARENA_HUGE_PAGE
+
+// SIMD 暂存区（scratch arena）：一次映射一大段按大页对齐的内存，分配只移动偏移量，释放只把偏移量移回去（O(1)），
+// 用于 SIMD 哈希函数内部“一次调用分配、调用结束即丢弃”的数据，即填充后的消息块和各通道的长度表
+// 生成的口令（q.guesses 中的 std::string）和摘要不在这里分配：口令几乎都落在短字符串缓冲区内，摘要在栈上
+// 优先使用预留的大页（MAP_HUGETLB），系统没有预留大页时退回普通映射并用 madvise 申请透明大页，减少 TLB 缺失
+class Arena
+{
+public:
+    ~Arena();
+
+    // 映射 capacity 字节（向上取整到大页），失败时返回 false
+    bool init(size_t capacity);
+
+    // 分配 size 字节，起始地址按 align（2 的幂）对齐；空间不足时终止程序
+    void *alloc(size_t size, size_t align = 16);
+
+    // 当前偏移量，之后可用 rewind 一次性释放此后的所有分配
+    size_t mark() const { return used; }
+    void rewind(size_t position) { used = position; }
+
+    // 释放全部分配（不归还物理页，下一轮直接复用）
+    void reset() { used = 0; }
+
+    // 解除映射
+    void release();
+
+    // 是否使用了预留的大页
+    bool hugetlb() const { return explicit_huge; }
+
+    size_t capacity() const { return size; }
+
+private:
+    char *base = NULL;
+    size_t size = 0;
+    size_t used = 0;
+    bool explicit_huge = false;
+};
+
+// 当前线程的 SIMD 暂存区（第一次调用时映射 ARENA_THREAD_SIZE 字节），SIMD 哈希函数用它存放填充后的消息块
+// 用法：size_t m = ThreadArena().mark(); ...分配并使用...; ThreadArena().rewind(m);
+Arena &ThreadArena();
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+#include "md5.h"
+#include "corpus.h"
+using namespace std;
+using namespace chrono;
+
+// 编译指令如下：
+// g++ bench.cpp corpus.cpp md5.cpp arena.cpp -o bench -O2 -fopenmp
+// 使用方法：
+// 1. 用 main 录制语料：mpirun -np 1 ./main --record=guesses.corpus --record-limit=10000000
+// 2. 回放：./bench guesses.corpus [线程数] [轮数]
+// 每个内核都对同一份语料计算哈希，输出耗时、吞吐量以及所有摘要的异或校验值（各内核的校验值应相同）
+
+// 一个待测的 MD5 内核：一次处理 lanes 个口令
+typedef struct {
+    const char *name;
+    int lanes;
+    void (*hash)(string *inputs, bit32 *state);
+} kernel_t;
+
+// 串行版本包装成与 SIMD 版本相同的接口
+static void MD5Hash_1(string *inputs, bit32 *state)
+{
+    MD5Hash(inputs[0], state);
+}
+
+static const kernel_t kernels[] = {
+    {"SIMD*0", 1, MD5Hash_1},
+    {"SIMD*2", 2, SIMDMD5Hash_2},
+    {"SIMD*4", 4, SIMDMD5Hash_4},
+    {"SIMD*8 (-)", 8, SIMDMD5Hash_8basic},
+    {"SIMD*8 (+)", 8, SIMDMD5Hash_8advanced},
+};
+
+/**
+ * HashSlice: 用一个内核计算一段口令的哈希，不足一组的尾部用串行版本计算
+ * @param kernel 内核
+ * @param inputs 口令
+ * @param n 口令数
+ * @return 所有摘要的异或
+ */
+static bit32 HashSlice(const kernel_t &kernel, string *inputs, size_t n)
+{
+    bit32 state[4 * 8];
+    bit32 checksum = 0;
+    size_t i = 0;
+    for (; i + kernel.lanes <= n; i += kernel.lanes) {
+        kernel.hash(inputs + i, state);
+        for (int j = 0; j < 4 * kernel.lanes; j++) {
+            checksum ^= state[j];
+        }
+    }
+    for (; i < n; i++) {
+        MD5Hash(inputs[i], state);
+        for (int j = 0; j < 4; j++) {
+            checksum ^= state[j];
+        }
+    }
+    return checksum;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <corpus> [threads] [rounds]" << endl;
+        return 1;
+    }
+    int threads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+    int rounds = (argc > 3) ? atoi(argv[3]) : 3;
+
+    GuessCorpus corpus;
+    if (!corpus.open(argv[1])) {
+        cerr << "Cannot open corpus: " << argv[1] << endl;
+        return 1;
+    }
+    size_t total = corpus.size();
+    cout << "Corpus: " << total << " guesses, " << threads << " threads, " << rounds << " rounds" << endl;
+
+    // 每个线程一段连续的口令，在计时之前从映射的文件中构造好 string，计时部分只包含哈希计算
+    vector<vector<string>> slices(threads);
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+    for (int t = 0; t < threads; t++) {
+        size_t begin = total * t / threads;
+        size_t end = total * (t + 1) / threads;
+        slices[t].reserve(end - begin);
+        for (size_t i = begin; i < end; i++) {
+            slices[t].push_back(corpus.get(i));
+        }
+    }
+
+    for (const kernel_t &kernel : kernels) {
+        double best = 0;
+        bit32 checksum = 0;
+        for (int r = 0; r < rounds; r++) {
+            checksum = 0;
+            auto start = system_clock::now();
+#pragma omp parallel for num_threads(threads) schedule(static, 1) reduction(^ : checksum)
+            for (int t = 0; t < threads; t++) {
+                checksum ^= HashSlice(kernel, slices[t].data(), slices[t].size());
+            }
+            auto end = system_clock::now();
+            double seconds = double(duration_cast<microseconds>(end - start).count()) * microseconds::period::num / microseconds::period::den;
+            if (r == 0 || seconds < best) {
+                best = seconds;
+            }
+        }
+        cout << left << setw(12) << kernel.name << right
+             << " best " << fixed << setprecision(4) << best << " s, "
+             << setprecision(2) << total / best / 1e6 << " MH/s, checksum "
+             << hex << setw(8) << setfill('0') << checksum << dec << setfill(' ') << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <climits>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+CheckpointWriter::CheckpointWriter()
+{
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+/**
+ * 析构：写线程先写完已提交的检查点再结束
+ */
+CheckpointWriter::~CheckpointWriter()
+{
+    if (started) {
+        pthread_mutex_lock(&mutex);
+        terminate = true;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&mutex);
+        pthread_join(thread, NULL);
+    }
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+}
+
+/**
+ * writerThread: 写线程，等待提交的检查点，写到临时文件后 rename 为正式文件
+ */
+void *CheckpointWriter::writerThread(void *writer)
+{
+    CheckpointWriter *w = (CheckpointWriter *)writer;
+    pthread_mutex_lock(&w->mutex);
+    while (true) {
+        while (!w->pending && !w->terminate) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (!w->pending && w->terminate) {
+            break;
+        }
+
+        // 写出时不持有锁；pending 为 true 期间生成线程不会修改这些数据
+        pthread_mutex_unlock(&w->mutex);
+        string tmp = w->path + ".tmp";
+        bool ok;
+        {
+            ofstream out(tmp, ios::binary | ios::trunc);
+            out.write((const char *)&w->header, sizeof(w->header));
+            out.write(w->state.data(), w->state.size());
+            out.flush();
+            ok = out.good();
+        }
+        ok = ok && rename(tmp.c_str(), w->path.c_str()) == 0;
+
+        pthread_mutex_lock(&w->mutex);
+        w->done += ok ? 1 : 0;
+        w->pending = false;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return NULL;
+}
+
+/**
+ * submit: 提交一个检查点，由写线程在后台写出
+ * @param path 检查点文件路径
+ * @param header 文件头（magic 和 state_bytes 在此填写）
+ * @param state 队列编码，内容被交换给写线程，返回后为上一个检查点的缓冲区（可复用）
+ */
+void CheckpointWriter::submit(const string &path, const checkpointHeader_t &header, vector<char> &state)
+{
+    if (!started) {
+        pthread_create(&thread, NULL, writerThread, this);
+        started = true;
+    }
+    pthread_mutex_lock(&mutex);
+    while (pending) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    this->path = path;
+    this->header = header;
+    memcpy(this->header.magic, CHECKPOINT_MAGIC, sizeof(this->header.magic));
+    this->header.state_bytes = state.size();
+    this->state.swap(state);
+    pending = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * wait: 等待已提交的检查点写完
+ */
+void CheckpointWriter::wait()
+{
+    pthread_mutex_lock(&mutex);
+    while (pending) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * LoadCheckpoint: 读取一个检查点文件
+ * @param path 文件路径
+ * @param[out] header 文件头
+ * @param[out] state 队列编码
+ * @return 是否成功
+ */
+bool LoadCheckpoint(const string &path, checkpointHeader_t &header, vector<char> &state)
+{
+    ifstream in(path, ios::binary);
+    if (!in.read((char *)&header, sizeof(header))) {
+        return false;
+    }
+    if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.state_bytes < 0) {
+        return false;
+    }
+    // 计数超出恢复后所用变量的范围（history / hashed / position 为 long long，命中数为 int）时视为损坏，不截断
+    if (header.history < 0 || header.hashed < 0 || header.position < 0 || header.cracked < 0 || header.cracked > INT_MAX
+        || header.hash_cracked < 0 || header.hash_cracked > INT_MAX) {
+        return false;
+    }
+    // 队列编码的字节数必须与文件中剩余的字节数一致，否则（截断或头部损坏）不按它分配内存
+    streamoff begin = in.tellg();
+    in.seekg(0, ios::end);
+    streamoff file_end = in.tellg();
+    if (begin < 0 || file_end < 0 || header.state_bytes != file_end - begin) {
+        return false;
+    }
+    in.seekg(begin);
+    state.resize(header.state_bytes);
+    return (bool)in.read(state.data(), state.size());
+}
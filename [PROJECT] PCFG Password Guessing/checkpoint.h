@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <pthread.h>
+
+using namespace std;
+
+// 检查点文件：checkpointHeader_t + 队列编码（PriorityQueue::SaveState）
+// 多进程时每个进程一个文件（<prefix>.<rank>），模型镜像只由 0 号进程写一次（<prefix>.model）
+#define CHECKPOINT_MAGIC "PCFGCK02"
+
+// 默认每生成这么多个猜测（所有进程合计）写一次检查点
+#define CHECKPOINT_GUESSES 100000000
+
+typedef struct {
+    char magic[8];
+    int32_t rank;           // 写出该文件的进程号
+    int32_t size;           // 进程数
+    int32_t backend;        // 生成方法（GenBackend）
+    int32_t distributed;    // 是否为分布式队列
+    int64_t history;        // 已经生成并处理完的猜测数（所有进程合计）
+    int64_t cracked;        // 本进程命中测试集的猜测数
+    int64_t hash_cracked;   // 本进程命中目标哈希的猜测数
+    int64_t hashed;         // 本进程哈希并比对过的猜测数
+    int64_t position;       // 本进程的猜测序号（本进程生成并处理完的猜测数，含 --skip 跳过的）
+    int64_t state_bytes;    // 其后队列编码的字节数
+} checkpointHeader_t;
+
+// 检查点写出线程：生成线程只需编码队列（内存拷贝），文件由后台线程写出，不阻塞生成；
+// 先写到临时文件再 rename，写到一半时中断也不会破坏上一个检查点
+class CheckpointWriter
+{
+public:
+    CheckpointWriter();
+    ~CheckpointWriter();
+
+    // 提交一个检查点（state 的内容被取走）；上一个检查点还没写完时先等待它完成
+    void submit(const string &path, const checkpointHeader_t &header, vector<char> &state);
+
+    // 等待已提交的检查点写完
+    void wait();
+
+    // 写出成功的检查点数
+    int written() const { return done; }
+
+private:
+    // 写线程函数
+    static void *writerThread(void *writer);
+
+    bool started = false;       // 写线程在第一次 submit 时启动
+
+    // 以下由 mutex 保护
+    bool pending = false;       // 是否有待写出的检查点
+    bool terminate = false;
+    string path;
+    checkpointHeader_t header;
+    vector<char> state;
+    int done = 0;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+// 读取一个检查点文件，文件不存在、格式不符或不完整时返回 false
+bool LoadCheckpoint(const string &path, checkpointHeader_t &header, vector<char> &state);
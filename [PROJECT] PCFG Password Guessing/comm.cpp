@@ -0,0 +1,122 @@
+#include "comm.h"
+
+using namespace std;
+
+CommThread::~CommThread()
+{
+    join();
+}
+
+/**
+ * start: 复制通信子，MPI 库支持多线程调用时启动通信线程
+ * MPI_Comm_dup 是集合通信，所有进程都要调用；各进程的线程支持级别相同，因此要么都启动线程，要么都不启动
+ * @param parent 被复制的通信子（一般为 MPI_COMM_WORLD）
+ */
+void CommThread::start(MPI_Comm parent)
+{
+    MPI_Comm_dup(parent, &communicator);
+
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+        return;
+    }
+
+    busy = 0;
+    terminate = false;
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+    pthread_create(&thread, NULL, commThread, this);
+    running = true;
+}
+
+/**
+ * commThread: 通信线程，依次取出任务执行；执行时不持有锁，主线程可以同时提交新任务
+ */
+void *CommThread::commThread(void *arg)
+{
+    CommThread *c = (CommThread *)arg;
+    pthread_mutex_lock(&c->mutex);
+    while (true) {
+        while (c->tasks.empty() && !c->terminate) {
+            pthread_cond_wait(&c->cond, &c->mutex);
+        }
+        if (c->tasks.empty() && c->terminate) {
+            break;
+        }
+        CommTask task = c->tasks.front();
+        c->tasks.pop_front();
+        pthread_mutex_unlock(&c->mutex);
+
+        task(c->communicator);
+
+        pthread_mutex_lock(&c->mutex);
+        c->busy -= 1;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+/**
+ * post: 提交一个通信任务；没有通信线程时立即在调用线程中执行
+ * @param task 通信任务，捕获的数据在任务完成之前必须保持有效
+ */
+void CommThread::post(const CommTask &task)
+{
+    if (!running) {
+        task(communicator);
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    tasks.push_back(task);
+    busy += 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * wait: 等待已提交的任务全部完成
+ */
+void CommThread::wait()
+{
+    if (!running) {
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    while (busy > 0) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * stop: 完成剩余任务，结束通信线程，释放通信子
+ */
+void CommThread::stop()
+{
+    join();
+    if (communicator != MPI_COMM_NULL) {
+        MPI_Comm_free(&communicator);
+    }
+}
+
+/**
+ * join: 完成剩余任务并结束通信线程（不释放通信子，析构时 MPI 可能已经结束）
+ */
+void CommThread::join()
+{
+    if (!running) {
+        return;
+    }
+    wait();
+    pthread_mutex_lock(&mutex);
+    terminate = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+    running = false;
+}
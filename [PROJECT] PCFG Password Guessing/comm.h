@@ -0,0 +1,58 @@
+#pragma once
+#include <mpi.h>
+#include <pthread.h>
+#include <deque>
+#include <functional>
+
+using namespace std;
+
+// 一个通信任务：在通信线程中以其通信子为参数执行（可以包含阻塞的 MPI 调用）
+typedef function<void(MPI_Comm)> CommTask;
+
+// 通信线程：生成 / 哈希线程把 MPI 通信（汇总、任务请求、结果交换）提交给它，按提交顺序在后台执行，
+// 自己继续计算，不再在阻塞的 MPI 调用中等待（OpenMP 线程也随之空闲）
+// 通信线程使用 MPI_COMM_WORLD 的副本作为通信子，与主线程在 MPI_COMM_WORLD 上的集合通信互不干扰；
+// 同一个通信子上的集合通信由各进程的通信线程按相同的顺序执行
+// 需要 MPI_THREAD_MULTIPLE（主线程和通信线程都会调用 MPI）；MPI 库不支持时不启动线程，
+// post 在调用线程中立即执行任务，行为与原先的阻塞通信相同
+class CommThread
+{
+public:
+    ~CommThread();
+
+    // 复制通信子，MPI 库支持 MPI_THREAD_MULTIPLE 时启动通信线程（集合通信，所有进程都要调用）
+    void start(MPI_Comm parent);
+
+    // 提交一个通信任务
+    void post(const CommTask &task);
+
+    // 等待已提交的任务全部完成
+    void wait();
+
+    // 完成剩余任务，结束通信线程并释放通信子（集合通信，所有进程都要调用）
+    void stop();
+
+    // 是否在后台线程中执行任务
+    bool threaded() const { return running; }
+
+    // 通信线程使用的通信子
+    MPI_Comm comm() const { return communicator; }
+
+private:
+    // 完成剩余任务并结束通信线程
+    void join();
+
+    // 通信线程函数
+    static void *commThread(void *arg);
+
+    MPI_Comm communicator = MPI_COMM_NULL;
+    bool running = false;
+
+    // 以下由 mutex 保护
+    deque<CommTask> tasks;      // 等待执行的任务
+    int busy = 0;               // 已提交、尚未完成的任务数（包括正在执行的）
+    bool terminate = false;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
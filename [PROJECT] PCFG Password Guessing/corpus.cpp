@@ -0,0 +1,130 @@
+#include "corpus.h"
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// 长度数组补齐到 8 字节后的大小
+static size_t LengthsSize(size_t count)
+{
+    return (count * sizeof(uint16_t) + 7) & ~(size_t)7;
+}
+
+/**
+ * append: 追加一批猜测
+ * @param guesses 猜测
+ * @param limit 语料中猜测数的上限
+ * @return 是否已达到上限
+ */
+bool CorpusRecorder::append(const vector<string> &guesses, size_t limit)
+{
+    for (const string &guess : guesses) {
+        if (lengths.size() >= limit) {
+            break;
+        }
+        // 长度字段为 16 位，过长的猜测截断（PCFG 生成的口令远短于此）
+        size_t length = min(guess.size(), (size_t)UINT16_MAX);
+        lengths.push_back((uint16_t)length);
+        bytes.append(guess.data(), length);
+    }
+    return lengths.size() >= limit;
+}
+
+/**
+ * save: 按 corpus.h 中的布局写出语料文件
+ * @param path 文件路径
+ * @return 是否成功
+ */
+bool CorpusRecorder::save(const string &path) const
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        return false;
+    }
+    corpusHeader_t header;
+    memcpy(header.magic, CORPUS_MAGIC, CORPUS_MAGIC_SIZE);
+    header.count = lengths.size();
+    header.bytes = bytes.size();
+    out.write((const char *)&header, sizeof(header));
+
+    out.write((const char *)lengths.data(), lengths.size() * sizeof(uint16_t));
+    static const char zeros[8] = {0};
+    out.write(zeros, LengthsSize(lengths.size()) - lengths.size() * sizeof(uint16_t));
+
+    out.write(bytes.data(), bytes.size());
+    return (bool)out;
+}
+
+GuessCorpus::~GuessCorpus()
+{
+    close();
+}
+
+/**
+ * open: 映射语料文件并计算偏移量
+ * @param path 文件路径
+ * @return 是否成功
+ */
+bool GuessCorpus::open(const string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(corpusHeader_t)) {
+        ::close(fd);
+        return false;
+    }
+    map_size = st.st_size;
+    map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        map = NULL;
+        return false;
+    }
+    // 回放时顺序读取整个文件
+    madvise(map, map_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    const corpusHeader_t *header = (const corpusHeader_t *)map;
+    size_t expected = sizeof(corpusHeader_t) + LengthsSize(header->count) + header->bytes;
+    if (memcmp(header->magic, CORPUS_MAGIC, CORPUS_MAGIC_SIZE) != 0 || expected != map_size) {
+        close();
+        return false;
+    }
+
+    count = header->count;
+    const uint16_t *lengths = (const uint16_t *)((const char *)map + sizeof(corpusHeader_t));
+    bytes = (const char *)map + sizeof(corpusHeader_t) + LengthsSize(count);
+
+    offsets.resize(count + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        offsets[i + 1] = offsets[i] + lengths[i];
+    }
+    if (offsets[count] != header->bytes) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * close: 解除映射
+ */
+void GuessCorpus::close()
+{
+    if (map != NULL) {
+        munmap(map, map_size);
+    }
+    map = NULL;
+    map_size = 0;
+    count = 0;
+    bytes = NULL;
+    offsets.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// 猜测语料文件：记录一次生成的前 N 个猜测，供哈希基准测试反复回放，使内核之间的比较不受 PCFG 生成开销影响
+// 文件布局（小端）：
+// 1. corpusHeader_t
+// 2. count 个 uint16_t，依次为每个猜测的长度（补齐到 8 字节）
+// 3. 所有猜测的字节依次紧密排列，没有分隔符
+#define CORPUS_MAGIC "PCFGGC01"
+#define CORPUS_MAGIC_SIZE 8
+
+typedef struct {
+    char magic[CORPUS_MAGIC_SIZE];
+    uint64_t count;     // 猜测数
+    uint64_t bytes;     // 猜测字节的总长度
+} corpusHeader_t;
+
+// 语料记录器：在内存中累积猜测，结束时一次写出
+class CorpusRecorder
+{
+public:
+    // 追加一批猜测，总数达到 limit 后不再追加；返回是否已达到 limit
+    bool append(const vector<string> &guesses, size_t limit);
+
+    // 写出语料文件
+    bool save(const string &path) const;
+
+    size_t size() const { return lengths.size(); }
+
+private:
+    vector<uint16_t> lengths;
+    string bytes;
+};
+
+// 语料文件的只读视图：用 mmap 映射整个文件，打开时只根据长度数组计算每个猜测的偏移量
+class GuessCorpus
+{
+public:
+    ~GuessCorpus();
+
+    // 映射语料文件，格式不符时返回 false
+    bool open(const string &path);
+
+    void close();
+
+    size_t size() const { return count; }
+
+    // 第 i 个猜测的起始地址和长度
+    const char *data(size_t i) const { return bytes + offsets[i]; }
+    size_t length(size_t i) const { return offsets[i + 1] - offsets[i]; }
+
+    // 第 i 个猜测（构造一个新的 string）
+    string get(size_t i) const { return string(data(i), length(i)); }
+
+private:
+    void *map = NULL;
+    size_t map_size = 0;
+    size_t count = 0;
+    const char *bytes = NULL;
+    vector<uint64_t> offsets;   // count + 1 个
+};
@@ -2,12 +2,13 @@
 #include <chrono>
 #include <fstream>
 #include "md5.h"
+#include "hashes.h"
 #include <iomanip>
 using namespace std;
 using namespace chrono;
 
 // 编译指令如下：
-// g++ correctness.cpp train.cpp guessing.cpp md5.cpp -o test.exe
+// g++ correctness.cpp train.cpp guessing.cpp md5.cpp hashes.cpp arena.cpp comm.cpp -o test.exe
 
 
 // 通过这个函数，你可以验证你实现的SIMD哈希函数的正确性
@@ -79,4 +80,48 @@ int main()
         }
         cout << endl;
     }
+
+    // 早退破解：长度为 57~63 的口令需要两个块（MD5Hash 的填充在这一区间会出错），走完整 MD5 的确认路径
+    // 以各通道的摘要为目标时掩码应为 f，改动第 3 个口令后应为 b；摘要可以与 python hashlib 的结果对照
+    cout << "Crack*4 (57~63):" << endl;
+    string inputs_crack[4] = {"abc", string(57, 'a'), string(60, 'b'), string(63, 'c')};
+    bit32 state_crack[4 * 4];
+    md5Midstate_t empty;
+    MD5Midstate("", empty);
+    SIMDMD5HashFrom_4(empty, inputs_crack, state_crack);
+    md5Target_t targets_crack[4];
+    for (int i1 = 0; i1 < 4; i1 += 1)
+    {
+        for(int i2 = 0; i2 < 4; i2 += 1){
+            cout << std::setw(8) << std::setfill('0') << hex << state_crack[i1*4 + i2];
+        }
+        cout << endl;
+        MD5ReverseTarget(state_crack + i1 * 4, targets_crack[i1]);
+    }
+    cout << "mask " << SIMDMD5Crack_4(inputs_crack, targets_crack, 4);
+    inputs_crack[2][0] = 'x';
+    cout << " -> " << SIMDMD5Crack_4(inputs_crack, targets_crack, 4) << endl;
+
+    // 其他哈希算法：四个通道分别为空串、"abc"、"password" 和一个需要两个块的长口令
+    // 可以与 openssl / python hashlib 的结果对照，例如 NTLM("password") 应为 8846f7eaee8fb117ad06bdd830b7586c
+    string inputs_other[4] = {"", "abc", "password",
+                              "bvaisdbjasdkafkasdfnavkjnakdjfejfanjsdnfkajdfkajdfjkwanfdjaknsvjkanbjbjadfajwefajksdfakdnsvjadfasjdva"};
+    bit32 state_other[4 * SHA256_DIGEST_WORDS];
+    const char *names[4] = {"MD4*4:", "NTLM*4:", "SHA1*4:", "SHA256*4:"};
+    const int words[4] = {MD4_DIGEST_WORDS, MD4_DIGEST_WORDS, SHA1_DIGEST_WORDS, SHA256_DIGEST_WORDS};
+    for (int k = 0; k < 4; k += 1)
+    {
+        cout << names[k] << endl;
+        if (k == 0) SIMDMD4Hash_4(inputs_other, state_other);
+        if (k == 1) SIMDNTLMHash_4(inputs_other, state_other);
+        if (k == 2) SIMDSHA1Hash_4(inputs_other, state_other);
+        if (k == 3) SIMDSHA256Hash_4(inputs_other, state_other);
+        for (int i1 = 0; i1 < 4; i1 += 1)
+        {
+            for(int i2 = 0; i2 < words[k]; i2 += 1){
+                cout << std::setw(8) << std::setfill('0') << hex << state_other[i1*words[k] + i2];
+            }
+            cout << endl;
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,507 @@
+#include "crack.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+using namespace std;
+
+/**
+ * HexValue: 单个十六进制字符的值，非法字符返回 -1
+ */
+static int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * ParseDigest: 将十六进制摘要字符串解析为 4 个 bit32
+ * 每 8 个字符按大端解析为一个字，与 state 按 setw(8) hex 输出的格式一致
+ * SHA-1 / SHA-256 的摘要只取前 128 位，与 SchemeHasher::hash4 的输出对应
+ * @param hex 摘要字符串（允许末尾带 \r 等空白）
+ * @param[out] digest 解析结果
+ * @return 是否解析成功
+ */
+bool ParseDigest(const string &hex, digest_t &digest) {
+    size_t digits = 0;
+    while (digits < hex.size() && HexValue(hex[digits]) >= 0) {
+        digits++;
+    }
+    if (digits != 32 && digits != 40 && digits != 64) {
+        return false;
+    }
+    for (size_t i = digits; i < hex.size(); i++) {
+        if (!isspace((unsigned char)hex[i])) {
+            return false;
+        }
+    }
+    for (int w = 0; w < 4; w++) {
+        bit32 value = 0;
+        for (int i = 0; i < 8; i++) {
+            int v = HexValue(hex[w * 8 + i]);
+            if (v < 0) {
+                return false;
+            }
+            value = (value << 4) | v;
+        }
+        digest.w[w] = value;
+    }
+    return true;
+}
+
+/**
+ * FormatDigest: 将摘要格式化为 32 位小写十六进制字符串
+ */
+string FormatDigest(const bit32 *digest) {
+    static const char table[] = "0123456789abcdef";
+    string hex(32, '0');
+    for (int w = 0; w < 4; w++) {
+        for (int i = 0; i < 8; i++) {
+            hex[w * 8 + i] = table[(digest[w] >> (28 - 4 * i)) & 0xf];
+        }
+    }
+    return hex;
+}
+
+static bool DigestLess(const digest_t &a, const digest_t &b) {
+    for (int w = 0; w < 4; w++) {
+        if (a.w[w] != b.w[w]) {
+            return a.w[w] < b.w[w];
+        }
+    }
+    return false;
+}
+
+static bool DigestEqual(const digest_t &a, const digest_t &b) {
+    return a.w[0] == b.w[0] && a.w[1] == b.w[1] && a.w[2] == b.w[2] && a.w[3] == b.w[3];
+}
+
+/**
+ * load: 加载目标哈希文件，构建有序数组、前缀索引和位图
+ * 每行为一个摘要，或 "摘要:盐值"（加盐方案），盐值去重后存入 salts
+ * @param path 文件路径
+ * @return 去重后的目标数
+ */
+int TargetSet::load(string path) {
+    ifstream file(path);
+    string line;
+    digest_t digest;
+    digests.clear();
+    salts.clear();
+    while (getline(file, line)) {
+        // 加盐的目标格式为 "摘要:盐值"
+        string salt;
+        size_t colon = line.find(':');
+        if (colon != string::npos) {
+            salt = line.substr(colon + 1);
+            if (!salt.empty() && salt.back() == '\r') {
+                salt.pop_back();
+            }
+            line = line.substr(0, colon);
+        }
+        if (ParseDigest(line, digest)) {
+            digests.push_back(digest);
+            if (colon != string::npos) {
+                salts.push_back(salt);
+            }
+        }
+    }
+    sort(salts.begin(), salts.end());
+    salts.erase(unique(salts.begin(), salts.end()), salts.end());
+
+    // 排序去重
+    sort(digests.begin(), digests.end(), DigestLess);
+    digests.erase(unique(digests.begin(), digests.end(), DigestEqual), digests.end());
+
+    // 前缀索引：统计每个前缀的个数，再做前缀和
+    prefix_index.assign((1u << TARGET_PREFIX_BITS) + 1, 0);
+    for (const digest_t &d : digests) {
+        prefix_index[(d.w[0] >> (32 - TARGET_PREFIX_BITS)) + 1]++;
+    }
+    for (size_t p = 1; p < prefix_index.size(); p++) {
+        prefix_index[p] += prefix_index[p - 1];
+    }
+
+    // 位图
+    bitmap.assign((1u << TARGET_BITMAP_BITS) / 64, 0);
+    for (const digest_t &d : digests) {
+        bit32 bit = d.w[1] & ((1u << TARGET_BITMAP_BITS) - 1);
+        bitmap[bit >> 6] |= 1ULL << (bit & 63);
+    }
+    return digests.size();
+}
+
+/**
+ * contains: 判断一个摘要是否在目标集合中
+ * @param digest 4 个 bit32 的摘要
+ */
+bool TargetSet::contains(const bit32 *digest) const {
+    if (digests.empty()) {
+        return false;
+    }
+    bit32 bit = digest[1] & ((1u << TARGET_BITMAP_BITS) - 1);
+    if (!(bitmap[bit >> 6] & (1ULL << (bit & 63)))) {
+        return false;
+    }
+    bit32 prefix = digest[0] >> (32 - TARGET_PREFIX_BITS);
+    digest_t key;
+    memcpy(key.w, digest, sizeof(key.w));
+    return binary_search(digests.begin() + prefix_index[prefix],
+                         digests.begin() + prefix_index[prefix + 1], key, DigestLess);
+}
+
+/**
+ * probe4: 检查 SIMDMD5Hash_4 的一个批次
+ * 使用 NEON 的 vld4q_u32 指令一次读入四个口令的摘要并按字转置，
+ * 在寄存器中同时计算四个通道的位图下标，只有通过位图的通道才进行精确查找
+ * @param state 四个口令的摘要，每 4 个 bit32 一个
+ * @return 命中的通道掩码
+ */
+int TargetSet::probe4(const bit32 *state) const {
+    if (digests.empty()) {
+        return 0;
+    }
+    // lanes.val[1]：四个通道摘要的第二个字
+    uint32x4x4_t lanes = vld4q_u32(state);
+    uint32x4_t bits = vandq_u32(lanes.val[1], vdupq_n_u32((1u << TARGET_BITMAP_BITS) - 1));
+
+    bit32 index[4];
+    vst1q_u32(index, bits);
+
+    int mask = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        if ((bitmap[index[lane] >> 6] & (1ULL << (index[lane] & 63))) && contains(state + lane * 4)) {
+            mask |= 1 << lane;
+        }
+    }
+    return mask;
+}
+
+// ============= 明文口令集合 ============= //
+
+/**
+ * PasswordHash: 口令的 64 位哈希
+ * 每次读入 8 个字节，用乘法和移位混合，最后做一次 finalizer 使所有位都充分混合
+ * 返回值保证非 0（0 用于标记空槽）
+ */
+static unsigned long long PasswordHash(const char *data, size_t len) {
+    const unsigned long long m = 0x9e3779b97f4a7c15ULL;
+    unsigned long long h = len * m;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        unsigned long long word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * m;
+        h ^= h >> 29;
+    }
+    if (i < len) {
+        unsigned long long word = 0;
+        memcpy(&word, data + i, len - i);
+        h = (h ^ word) * m;
+        h ^= h >> 29;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h ? h : 1;
+}
+
+/**
+ * BloomBlock: 哈希对应的布隆过滤器块（每块 8 个 64 位字，即一条缓存行）
+ * 块内的位用掉了哈希的低 9 * PWSET_BLOOM_HASHES = 54 位，剩下的高位不够选出所有的块；
+ * 直接取 h >> 32 时块号与第 4、5 个位的哈希（第 36~53 位）重叠，同一块内这两个位不再独立，误判率升高。
+ * 这里先把哈希再混合一次（乘以奇常数），块号取乘积的高 32 位，它依赖于哈希的所有位，与块内的位没有固定的对应关系
+ */
+static inline size_t BloomBlock(unsigned long long h, size_t bloom_mask) {
+    unsigned long long mixed = (h ^ (h >> 31)) * 0x9e3779b97f4a7c15ULL;
+    return ((mixed >> 32) & bloom_mask) * 8;
+}
+
+/**
+ * BloomTest: 判断哈希对应的 PWSET_BLOOM_HASHES 个位是否全部被设置
+ * 每个位用 9 位哈希选出（块内 512 位），依次从低位取出
+ */
+static inline bool BloomTest(const unsigned long long *block, unsigned long long h) {
+    for (int k = 0; k < PWSET_BLOOM_HASHES; k++) {
+        unsigned int bit = (h >> (9 * k)) & 511;
+        if (!(block[bit >> 6] & (1ULL << (bit & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * reserve: 保证能容纳 keys 个口令
+ * 表的槽数为不小于 2 * keys 的 2 的幂；扩容时重新插入已有口令，并按新的大小重建布隆过滤器
+ */
+void PasswordSet::reserve(size_t keys) {
+    size_t slots = 16;
+    while (slots < keys * 2) {
+        slots <<= 1;
+    }
+    if (slots <= table.size()) {
+        return;
+    }
+
+    size_t blocks = 1;
+    while (blocks * 512 < keys * PWSET_BLOOM_BITS_PER_KEY) {
+        blocks <<= 1;
+    }
+
+    vector<slot_t> old_table;
+    old_table.swap(table);
+    table.assign(slots, slot_t{0, 0, 0});
+    table_mask = slots - 1;
+    bloom.assign(blocks * 8, 0);
+    bloom_mask = blocks - 1;
+
+    for (const slot_t &slot : old_table) {
+        if (slot.fingerprint == 0) {
+            continue;
+        }
+        unsigned long long h = slot.fingerprint;
+        unsigned long long *block = bloom.data() + BloomBlock(h, bloom_mask);
+        for (int k = 0; k < PWSET_BLOOM_HASHES; k++) {
+            unsigned int bit = (h >> (9 * k)) & 511;
+            block[bit >> 6] |= 1ULL << (bit & 63);
+        }
+        size_t pos = h & table_mask;
+        while (table[pos].fingerprint != 0) {
+            pos = (pos + 1) & table_mask;
+        }
+        table[pos] = slot;
+    }
+}
+
+/**
+ * probe: 在开放寻址表中查找口令
+ * @param pw 口令
+ * @param h 口令的哈希
+ */
+bool PasswordSet::probe(const string &pw, unsigned long long h) const {
+    size_t pos = h & table_mask;
+    while (table[pos].fingerprint != 0) {
+        const slot_t &slot = table[pos];
+        if (slot.fingerprint == h && slot.length == pw.size()
+            && memcmp(arena.data() + slot.offset, pw.data(), pw.size()) == 0) {
+            return true;
+        }
+        pos = (pos + 1) & table_mask;
+    }
+    return false;
+}
+
+/**
+ * insert: 插入一个口令，重复插入会被忽略
+ * @param pw 口令
+ */
+void PasswordSet::insert(const string &pw) {
+    reserve(num_keys + 1);
+    unsigned long long h = PasswordHash(pw.data(), pw.size());
+    if (probe(pw, h)) {
+        return;
+    }
+
+    unsigned long long *block = bloom.data() + BloomBlock(h, bloom_mask);
+    for (int k = 0; k < PWSET_BLOOM_HASHES; k++) {
+        unsigned int bit = (h >> (9 * k)) & 511;
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+
+    size_t pos = h & table_mask;
+    while (table[pos].fingerprint != 0) {
+        pos = (pos + 1) & table_mask;
+    }
+    table[pos].fingerprint = h;
+    table[pos].offset = arena.size();
+    table[pos].length = pw.size();
+    arena.insert(arena.end(), pw.begin(), pw.end());
+    num_keys++;
+}
+
+/**
+ * load: 从文件中读入口令，与原先构建 test_set 的方式相同（以空白分隔，至多 limit 个）
+ * @param path 文件路径
+ * @param limit 读入的口令数上限
+ * @return 读入的口令数（含重复）
+ */
+int PasswordSet::load(string path, int limit) {
+    ifstream file(path);
+    string pw;
+    int loaded = 0;
+    // 先按上限预留空间，避免读入过程中反复扩容重建
+    reserve(limit);
+    arena.reserve((size_t)limit * 10);
+    while (loaded < limit && file >> pw) {
+        insert(pw);
+        loaded++;
+    }
+    return loaded;
+}
+
+/**
+ * contains: 判断一个口令是否在集合中
+ */
+bool PasswordSet::contains(const string &pw) const {
+    if (num_keys == 0) {
+        return false;
+    }
+    unsigned long long h = PasswordHash(pw.data(), pw.size());
+    if (!BloomTest(bloom.data() + BloomBlock(h, bloom_mask), h)) {
+        return false;
+    }
+    return probe(pw, h);
+}
+
+/**
+ * count: 批量查询 pw[0..n) 中在集合中的口令数
+ * 每组 PWSET_BATCH 个口令分三个阶段处理：
+ * 1. 计算哈希，预取对应的布隆过滤器块
+ * 2. 检查布隆过滤器，对通过的口令预取表中的起始槽
+ * 3. 对通过的口令探测表并精确比较
+ * @param pw 口令数组
+ * @param n 口令数
+ * @param[out] hits 非空时，依次追加命中口令的下标
+ */
+int PasswordSet::count(const string *pw, int n, vector<int> *hits) const {
+    if (num_keys == 0) {
+        return 0;
+    }
+    unsigned long long hashes[PWSET_BATCH];
+    int candidates[PWSET_BATCH];
+    int found = 0;
+
+    for (int base = 0; base < n; base += PWSET_BATCH) {
+        int batch = min(PWSET_BATCH, n - base);
+
+        for (int i = 0; i < batch; i++) {
+            hashes[i] = PasswordHash(pw[base + i].data(), pw[base + i].size());
+            __builtin_prefetch(bloom.data() + BloomBlock(hashes[i], bloom_mask));
+        }
+
+        int num_candidates = 0;
+        for (int i = 0; i < batch; i++) {
+            if (BloomTest(bloom.data() + BloomBlock(hashes[i], bloom_mask), hashes[i])) {
+                candidates[num_candidates++] = i;
+                __builtin_prefetch(&table[hashes[i] & table_mask]);
+            }
+        }
+
+        for (int c = 0; c < num_candidates; c++) {
+            int i = candidates[c];
+            if (probe(pw[base + i], hashes[i])) {
+                found++;
+                if (hits != NULL) {
+                    hits->push_back(base + i);
+                }
+            }
+        }
+    }
+    return found;
+}
+
+// ============= 哈希方案 ============= //
+
+static const char *scheme_names[SCHEME_NUM] = {"md5", "salt_pw", "pw_salt", "md5_md5", "md4", "ntlm", "sha1", "sha256"};
+
+/**
+ * setScheme: 按名称选择哈希方案
+ * @param name 方案名称：md5 / salt_pw / pw_salt / md5_md5 / md4 / ntlm / sha1 / sha256
+ * @return 名称是否有效
+ */
+bool SchemeHasher::setScheme(const string &name) {
+    for (int i = 0; i < SCHEME_NUM; i++) {
+        if (name == scheme_names[i]) {
+            scheme = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * setSalts: 设置盐值，并为每个盐值预先计算前缀中间状态
+ * md5(salt.pw) 中盐值是前缀，盐值中完整的 64 字节块只需处理一次；其余方案只需要空前缀（即 MD5 初始状态）
+ * @param salt_list 盐值列表
+ */
+void SchemeHasher::setSalts(const vector<string> &salt_list) {
+    salts = salt_list;
+    MD5Midstate("", plain);
+    mids.clear();
+    if (scheme == SCHEME_SALT_PW) {
+        mids.resize(salts.size());
+        for (size_t s = 0; s < salts.size(); s++) {
+            MD5Midstate(salts[s], mids[s]);
+        }
+    }
+}
+
+/**
+ * saltCount: 每个口令需要计算的哈希数（不加盐的方案为 1）
+ */
+int SchemeHasher::saltCount() const {
+    return salted() ? salts.size() : 1;
+}
+
+/**
+ * hash4: 按当前方案计算 4 个口令在第 salt_index 个盐值下的哈希
+ * @param inputs 输入（4 个口令，不足时用空串补齐，对应通道的结果忽略即可）
+ * @param salt_index 盐值下标，不加盐的方案忽略
+ * @param[out] state 结果，格式与 SIMDMD5Hash_4 相同
+ */
+void SchemeHasher::hash4(string *inputs, int salt_index, bit32 *state) const {
+    if (scheme == SCHEME_SALT_PW) {
+        SIMDMD5HashFrom_4(mids[salt_index], inputs, state);
+    }
+    else if (scheme == SCHEME_PW_SALT) {
+        string salted[4];
+        for (int i = 0; i < 4; i++) {
+            salted[i] = inputs[i] + salts[salt_index];
+        }
+        SIMDMD5HashFrom_4(plain, salted, state);
+    }
+    else if (scheme == SCHEME_MD5_MD5) {
+        // 内层摘要按 32 位小写十六进制字符串作为外层的输入
+        string inner[4];
+        SIMDMD5HashFrom_4(plain, inputs, state);
+        for (int i = 0; i < 4; i++) {
+            inner[i] = FormatDigest(state + i * 4);
+        }
+        SIMDMD5HashFrom_4(plain, inner, state);
+    }
+    else if (scheme == SCHEME_MD4) {
+        SIMDMD4Hash_4(inputs, state);
+    }
+    else if (scheme == SCHEME_NTLM) {
+        SIMDNTLMHash_4(inputs, state);
+    }
+    else if (scheme == SCHEME_SHA1 || scheme == SCHEME_SHA256) {
+        // 完整摘要按口令依次存放，每个口令只保留前 4 个字
+        bit32 full[4 * SHA256_DIGEST_WORDS];
+        int words = SHA1_DIGEST_WORDS;
+        if (scheme == SCHEME_SHA1) {
+            SIMDSHA1Hash_4(inputs, full);
+        }
+        else {
+            SIMDSHA256Hash_4(inputs, full);
+            words = SHA256_DIGEST_WORDS;
+        }
+        for (int i = 0; i < 4; i++) {
+            memcpy(state + i * 4, full + i * words, 4 * sizeof(bit32));
+        }
+    }
+    else {
+        SIMDMD5HashFrom_4(plain, inputs, state);
+    }
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "md5.h"
+#include "hashes.h"
+
+using namespace std;
+
+// 前缀过滤位图的位数（2^24 bit = 2MB，可常驻 L2/L3 缓存）
+#define TARGET_BITMAP_BITS 24
+
+// 前缀索引的位数：按 MD5 第一个字的高 16 位划分区间
+#define TARGET_PREFIX_BITS 16
+
+// 目标数不超过该值时使用早退破解内核 SIMDMD5Crack_4（逐个比较早退值），否则计算完整摘要后查表
+#define CRACK_EARLY_MAX_TARGETS 16
+
+// 明文集合的参数
+#define PWSET_BLOOM_BITS_PER_KEY 16     // 布隆过滤器每个口令占用的位数
+#define PWSET_BLOOM_HASHES 6            // 布隆过滤器在一个块内设置的位数
+#define PWSET_BATCH 64                  // 批量查询一次处理的口令数（分阶段预取）
+
+// 一个 MD5 摘要，4 个 bit32 与 MD5Hash/SIMDMD5Hash_4 输出的 state 格式相同（按十六进制输出即为常见的摘要字符串）
+typedef struct {
+    bit32 w[4];
+} digest_t;
+
+// 目标哈希集合：加载数百万个目标 MD5，用于判断生成的口令哈希是否命中
+// 存储结构：
+// 1. 位图预过滤：以摘要第二个字的低 TARGET_BITMAP_BITS 位为下标，绝大多数未命中在这一步就被排除
+// 2. 有序数组 + 前缀索引：通过前缀索引定位到第一个字高 16 位相同的一小段，再在其中二分查找
+class TargetSet
+{
+public:
+    // 从文件加载目标哈希，每行一个 32 位十六进制摘要（大小写均可），无法解析的行会被跳过
+    // 返回成功加载的（去重后）目标数
+    int load(string path);
+
+    // 判断一个摘要是否在目标集合中
+    bool contains(const bit32 *digest) const;
+
+    // 检查一个四路 SIMD 批次的哈希结果（state 布局与 SIMDMD5Hash_4 输出相同）
+    // 返回命中的通道掩码，第 i 位为 1 表示第 i 个口令命中
+    int probe4(const bit32 *state) const;
+
+    // 目标数
+    size_t size() const { return digests.size(); }
+
+    // 所有目标摘要（有序）
+    const vector<digest_t> &list() const { return digests; }
+
+    // 目标文件中出现过的盐值（去重）。所有盐值的目标放在同一个集合中，
+    // 某个盐值下算出的摘要命中任意目标即视为命中（不同盐值的摘要碰撞的概率可以忽略）
+    vector<string> salts;
+
+private:
+    // 排序去重之后的目标摘要
+    vector<digest_t> digests;
+
+    // 前缀索引：第一个字高 16 位为 p 的摘要位于 [prefix_index[p], prefix_index[p+1])
+    vector<unsigned int> prefix_index;
+
+    // 位图预过滤
+    vector<unsigned long long> bitmap;
+};
+
+// 哈希方案
+enum HashScheme {
+    SCHEME_MD5 = 0,     // md5(pw)
+    SCHEME_SALT_PW,     // md5(salt.pw)
+    SCHEME_PW_SALT,     // md5(pw.salt)
+    SCHEME_MD5_MD5,     // md5(md5(pw))，内层摘要以 32 位小写十六进制作为外层输入
+    SCHEME_MD4,         // md4(pw)
+    SCHEME_NTLM,        // md4(utf16le(pw))
+    SCHEME_SHA1,        // sha1(pw)
+    SCHEME_SHA256,      // sha256(pw)
+    SCHEME_NUM
+};
+
+// 按哈希方案计算一批口令的哈希
+// 破解多个盐值时，每批口令依次与所有盐值组合计算（口令只生成一次，在缓存中被反复使用），
+// md5(salt.pw) 的盐值前缀中间状态在 setSalts 时预先计算
+class SchemeHasher
+{
+public:
+    int scheme = SCHEME_MD5;
+
+    // 按名称选择方案，名称无效时返回 false
+    bool setScheme(const string &name);
+
+    // 设置盐值（需在 setScheme 之后调用）
+    void setSalts(const vector<string> &salt_list);
+
+    // 是否为加盐方案
+    bool salted() const { return scheme == SCHEME_SALT_PW || scheme == SCHEME_PW_SALT; }
+
+    // 每个口令需要计算的哈希数
+    int saltCount() const;
+
+    // 计算 4 个口令在第 salt_index 个盐值下的哈希
+    // 结果每个口令 4 个 bit32：SHA 系列的摘要更长，只保留前 128 位用于与目标比对
+    void hash4(string *inputs, int salt_index, bit32 *state) const;
+
+    vector<string> salts;
+
+private:
+    md5Midstate_t plain;            // 空前缀的中间状态，即 MD5 初始状态
+    vector<md5Midstate_t> mids;     // 各盐值前缀的中间状态（仅 md5(salt.pw)）
+};
+
+// 将十六进制摘要字符串解析为 digest_t，成功返回 true
+// 接受 32 / 40 / 64 位十六进制（MD5/MD4/NTLM、SHA-1、SHA-256），较长的摘要只保留前 128 位
+bool ParseDigest(const string &hex, digest_t &digest);
+
+// 将摘要格式化为 32 位十六进制字符串
+string FormatDigest(const bit32 *digest);
+
+// 明文口令集合：替代 unordered_set<string>，判断生成的猜测是否在测试集中
+// 存储结构：
+// 1. 分块布隆过滤器：每个口令的所有位都落在同一个 64 字节（一条缓存行）的块中，一次访存即可排除绝大多数未命中
+// 2. 开放寻址表：每个槽存放口令的 64 位指纹及其在 arena 中的位置，线性探测
+// 3. arena：所有口令首尾相接存放在一块连续内存中，指纹相同时用于精确比较
+class PasswordSet
+{
+public:
+    // 从文件中读入至多 limit 个口令（以空白分隔），返回读入的口令数
+    int load(string path, int limit);
+
+    // 插入一个口令
+    void insert(const string &pw);
+
+    // 判断一个口令是否在集合中
+    bool contains(const string &pw) const;
+
+    // 批量查询：统计 pw[0..n) 中在集合中的口令数，hits 非空时同时记录命中口令的下标
+    // 按 PWSET_BATCH 分组，先计算哈希并预取布隆过滤器的块，再预取表中的槽，最后依次比较，使访存延迟相互重叠
+    int count(const string *pw, int n, vector<int> *hits = NULL) const;
+
+    size_t size() const { return num_keys; }
+
+private:
+    struct slot_t {
+        unsigned long long fingerprint;     // 口令的 64 位哈希，0 表示空槽
+        unsigned int offset;                // 口令在 arena 中的起始位置
+        unsigned int length;                // 口令长度
+    };
+
+    // 按需扩容，保证表的装填因子不超过 1/2，并按新的口令数重建布隆过滤器
+    void reserve(size_t keys);
+
+    // 在表中查找，返回是否存在
+    bool probe(const string &pw, unsigned long long h) const;
+
+    vector<unsigned long long> bloom;       // 布隆过滤器，每 8 个字为一块
+    size_t bloom_mask = 0;                  // 块数 - 1
+    vector<slot_t> table;
+    size_t table_mask = 0;                  // 槽数 - 1
+    vector<char> arena;
+    size_t num_keys = 0;
+};
@@ -0,0 +1,156 @@
+#include "curve.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * init: 设置记录线程数，清空已有记录
+ * @param num_threads 会调用 record 的线程数（线程号 0 ~ num_threads-1）
+ */
+void CrackCurve::init(int num_threads) {
+    buffers.assign(num_threads, threadHits_t());
+    hits.clear();
+    points.clear();
+    for (int k = 0; k < HIT_KIND_NUM; k++) {
+        cracked[k].clear();
+        counts[k] = 0;
+    }
+    pt_stats.clear();
+    next_point = 1;
+    next_exponent = 0;
+    scanned = 0;
+}
+
+/**
+ * record: 第 t 个线程记录一次命中
+ * 命中很少，这里只是一次 push_back，不加锁：每个线程只写自己的缓冲区，合并发生在 checkpoint 中（此时没有线程在记录）
+ */
+void CrackCurve::record(int t, long long guess, int kind, const string &pattern, const string &password) {
+    buffers[t].hits.push_back(hit_t{guess, kind, pattern, password});
+}
+
+/**
+ * advancePoint: 下一个对数间隔的记录点 round(10^(k / CURVE_POINTS_PER_DECADE))，跳过取整后重复的点
+ */
+void CrackCurve::advancePoint() {
+    long long point = next_point;
+    while (point <= next_point) {
+        next_exponent++;
+        point = llround(pow(10.0, (double)next_exponent / CURVE_POINTS_PER_DECADE));
+    }
+    next_point = point;
+}
+
+/**
+ * checkpoint: 合并各线程的缓冲区，输出 guesses_done 之内的记录点
+ * 调用时 guesses_done 之前的猜测都已检查完毕，之后记录的命中猜测序号都不小于 guesses_done
+ * @param guesses_done 已生成（并检查）的猜测数
+ * @param final 是否为最后一个检查点
+ */
+void CrackCurve::checkpoint(long long guesses_done, bool final) {
+    size_t merged_begin = hits.size();
+    for (threadHits_t &buffer : buffers) {
+        for (hit_t &hit : buffer.hits) {
+            ptStat_t &stat = pt_stats[hit.pattern];
+            stat.hits[hit.kind]++;
+            if (stat.first_guess < 0 || hit.guess < stat.first_guess) {
+                stat.first_guess = hit.guess;
+            }
+            hits.push_back(hit);
+        }
+        buffer.hits.clear();
+    }
+    // 新合并的命中都在此前的检查点之后，只需对新的部分排序
+    sort(hits.begin() + merged_begin, hits.end(),
+         [](const hit_t &a, const hit_t &b) { return a.guess < b.guess; });
+
+    // 记录点 p 上的破解数为猜测序号小于 p 的命中数
+    while (next_point <= guesses_done) {
+        while (scanned < hits.size() && hits[scanned].guess < next_point) {
+            counts[hits[scanned].kind]++;
+            scanned++;
+        }
+        points.push_back(next_point);
+        for (int k = 0; k < HIT_KIND_NUM; k++) {
+            cracked[k].push_back(counts[k]);
+        }
+        advancePoint();
+    }
+
+    if (final && (points.empty() || points.back() < guesses_done)) {
+        long long final_counts[HIT_KIND_NUM] = {};
+        for (const hit_t &hit : hits) {
+            if (hit.guess < guesses_done) {
+                final_counts[hit.kind]++;
+            }
+        }
+        points.push_back(guesses_done);
+        for (int k = 0; k < HIT_KIND_NUM; k++) {
+            cracked[k].push_back(final_counts[k]);
+        }
+    }
+}
+
+/**
+ * write: 输出曲线和命中统计
+ * @param prefix 输出文件名前缀
+ */
+void CrackCurve::write(const string &prefix) const {
+    ofstream curve(prefix + ".csv");
+    curve << "guesses,cracked_testset,cracked_targets" << endl;
+    for (size_t i = 0; i < points.size(); i++) {
+        curve << points[i] << "," << cracked[HIT_TESTSET][i] << "," << cracked[HIT_TARGET][i] << endl;
+    }
+
+    ofstream pt(prefix + "_pt.csv");
+    pt << "pattern,hits_testset,hits_targets,first_guess" << endl;
+    for (const auto &entry : pt_stats) {
+        pt << entry.first << "," << entry.second.hits[HIT_TESTSET] << "," << entry.second.hits[HIT_TARGET]
+           << "," << entry.second.first_guess << endl;
+    }
+
+    // JSON 中的口令需要转义引号、反斜杠和控制字符
+    auto quote = [](const string &text) {
+        string out = "\"";
+        for (unsigned char ch : text) {
+            if (ch == '"' || ch == '\\') {
+                out += '\\';
+                out += ch;
+            }
+            else if (ch < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                out += buf;
+            }
+            else {
+                out += ch;
+            }
+        }
+        return out + "\"";
+    };
+
+    ofstream json(prefix + ".json");
+    json << "{\n  \"curve\": [";
+    for (size_t i = 0; i < points.size(); i++) {
+        json << (i ? "," : "") << "\n    {\"guesses\": " << points[i] << ", \"cracked_testset\": " << cracked[HIT_TESTSET][i]
+             << ", \"cracked_targets\": " << cracked[HIT_TARGET][i] << "}";
+    }
+    json << "\n  ],\n  \"patterns\": [";
+    bool first = true;
+    for (const auto &entry : pt_stats) {
+        json << (first ? "" : ",") << "\n    {\"pattern\": " << quote(entry.first)
+             << ", \"hits_testset\": " << entry.second.hits[HIT_TESTSET]
+             << ", \"hits_targets\": " << entry.second.hits[HIT_TARGET]
+             << ", \"first_guess\": " << entry.second.first_guess << "}";
+        first = false;
+    }
+    json << "\n  ],\n  \"hits\": [";
+    for (size_t i = 0; i < hits.size(); i++) {
+        json << (i ? "," : "") << "\n    {\"guess\": " << hits[i].guess
+             << ", \"kind\": \"" << (hits[i].kind == HIT_TESTSET ? "testset" : "target") << "\""
+             << ", \"pattern\": " << quote(hits[i].pattern) << ", \"password\": " << quote(hits[i].password) << "}";
+    }
+    json << "\n  ]\n}" << endl;
+}
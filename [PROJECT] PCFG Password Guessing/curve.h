@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// 每个数量级内的记录点数：记录点取 10^(k / CURVE_POINTS_PER_DECADE)（取整、去重）
+#define CURVE_POINTS_PER_DECADE 10
+
+// 命中的种类
+enum HitKind {
+    HIT_TESTSET = 0,    // 口令在测试集中（即 main 中的 Cracked）
+    HIT_TARGET,         // 口令的哈希命中目标哈希
+    HIT_KIND_NUM
+};
+
+// 一次命中
+typedef struct {
+    long long guess;    // 猜测序号（从 0 开始）
+    int kind;           // HitKind
+    string pattern;     // 来源 PT 的结构
+    string password;    // 命中的口令
+} hit_t;
+
+// 破解曲线记录器：记录 "已破解数 - 猜测数" 曲线，以及每个命中来自哪个 PT、第几个猜测
+// 每个线程只向自己的缓冲区追加命中（无锁，缓冲区按缓存行对齐，互不共享），
+// 只在检查点（每次清空 guesses 之后）由主线程合并，并计算已经越过的记录点上的破解数
+class CrackCurve
+{
+public:
+    // 设置记录线程数，清空已有记录
+    void init(int num_threads);
+
+    // 第 t 个线程记录一次命中，只访问该线程自己的缓冲区
+    void record(int t, long long guess, int kind, const string &pattern, const string &password);
+
+    // 检查点：已生成 guesses_done 个猜测，此前的命中都已记录。合并各线程的缓冲区，并输出 guesses_done 之内的所有记录点
+    // final 为 true 时（结束时），额外在 guesses_done 处补一个记录点
+    void checkpoint(long long guesses_done, bool final = false);
+
+    // 输出：<prefix>.csv 为曲线（猜测数, 各种类的破解数），<prefix>_pt.csv 为各 PT 的命中统计，
+    // <prefix>.json 包含曲线、PT 统计和每一个命中
+    void write(const string &prefix) const;
+
+private:
+    // 按缓存行对齐的线程缓冲区，避免不同线程的写入发生伪共享
+    struct alignas(64) threadHits_t {
+        vector<hit_t> hits;
+    };
+    vector<threadHits_t> buffers;
+
+    // 合并后的命中，按猜测序号升序
+    vector<hit_t> hits;
+
+    // 曲线：points[i] 个猜测之内各种类的破解数
+    vector<long long> points;
+    vector<long long> cracked[HIT_KIND_NUM];
+
+    // 下一个记录点
+    long long next_point = 1;
+    int next_exponent = 0;
+    // 已合并的命中中，猜测序号小于下一个记录点的数目（按种类）
+    size_t scanned = 0;
+    long long counts[HIT_KIND_NUM] = {};
+
+    // 各 PT 的命中统计
+    struct ptStat_t {
+        long long hits[HIT_KIND_NUM] = {};
+        long long first_guess = -1;
+    };
+    map<string, ptStat_t> pt_stats;
+
+    // 推进到下一个记录点
+    void advancePoint();
+};
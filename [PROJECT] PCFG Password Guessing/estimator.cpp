@@ -0,0 +1,190 @@
+#include "estimator.h"
+#include <random>
+#include <cctype>
+
+using namespace std;
+
+/**
+ * buildTables: 为一类 segment（letters / digits / symbols）建立采样和查询表
+ * value 直接从模型镜像中读取（ValueData），训练数据释放之后同样可用
+ * @param segs 模型中的 segment
+ * @param[out] tables 与 segs 一一对应的表
+ */
+void GuessEstimator::buildTables(vector<segment> &segs, vector<segTable_t> &tables)
+{
+    tables.assign(segs.size(), segTable_t());
+    for (size_t s = 0; s < segs.size(); s++) {
+        segment &seg = segs[s];
+        segTable_t &table = tables[s];
+        double total = 0;
+        table.class_probs = seg.class_probs;
+        table.class_starts = seg.class_starts;
+        table.class_cdf.resize(seg.ClassCount());
+        for (int c = 0; c < seg.ClassCount(); c++) {
+            total += (double)seg.class_probs[c] * (seg.class_starts[c + 1] - seg.class_starts[c]);
+            table.class_cdf[c] = total;
+        }
+        table.value_index.reserve(seg.ValueCount());
+        for (int i = 0; i < seg.ValueCount(); i++) {
+            table.value_index.emplace(string(seg.ValueData(i), seg.ValueLength(i)), i);
+        }
+    }
+}
+
+/**
+ * sample: 从模型中采样一个猜测：按概率选取初始 PT，再为每个 segment 按概率选取 value 类
+ * （类中的 value 概率相同，选取类就确定了概率，不需要取出具体的 value）
+ * 猜测所在 PT 的概率与队列中相同：最后一个 segment 取第一个类（概率最高）的 value 概率
+ * @param rng 随机数发生器
+ * @param[out] pt_prob 猜测所在 PT 的概率
+ * @return 采样到的猜测的概率
+ */
+template <typename Rng>
+double GuessEstimator::sample(Rng &rng, double &pt_prob) const
+{
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    int r = upper_bound(root_cdf.begin(), root_cdf.end(), uniform(rng) * root_cdf.back()) - root_cdf.begin();
+    r = min(r, (int)roots.size() - 1);
+    const PT &pt = roots[r];
+
+    double prob = pt.preterm_prob;
+    size_t last = pt.content.size() - 1;
+    for (size_t k = 0; k <= last; k++) {
+        const segTable_t &table = tables[pt.content[k].type - 1][pt.seg_ids[k]];
+        int c = upper_bound(table.class_cdf.begin(), table.class_cdf.end(), uniform(rng) * table.class_cdf.back())
+                - table.class_cdf.begin();
+        c = min(c, (int)table.class_probs.size() - 1);
+        if (k == last) {
+            pt_prob = prob * table.class_probs[0];
+        }
+        prob *= table.class_probs[c];
+    }
+    return prob;
+}
+
+/**
+ * build: 建立估计器
+ * 1. 由队列中的初始 PT 建立 PT 的累积概率表和结构索引，由模型建立各 segment 的表
+ * 2. 多线程采样 n 个猜测的概率：按块划分，每块的随机数种子由 seed 和块号确定
+ * 3. 按所在 PT 的概率降序排列，累加权重 1 / (n * 猜测的概率)
+ * @param q 已经 init 的优先队列
+ * @param n 采样数
+ * @param seed 随机数种子
+ * @param threads 线程数
+ */
+void GuessEstimator::build(PriorityQueue &q, size_t n, unsigned long long seed, int threads)
+{
+    buildTables(q.m.letters, tables[0]);
+    buildTables(q.m.digits, tables[1]);
+    buildTables(q.m.symbols, tables[2]);
+
+    roots = q.priority;
+    root_cdf.resize(roots.size());
+    root_index.clear();
+    double total = 0;
+    for (size_t r = 0; r < roots.size(); r++) {
+        total += roots[r].preterm_prob;
+        root_cdf[r] = total;
+        root_index.emplace(roots[r].Pattern(), r);
+    }
+
+    vector<sample_t> drawn(n);
+    size_t chunks = (n + ESTIMATOR_CHUNK - 1) / ESTIMATOR_CHUNK;
+    #pragma omp parallel for num_threads(threads) schedule(dynamic)
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        mt19937_64 rng(seed * 0x9e3779b97f4a7c15ULL + chunk);
+        size_t end = min(n, (chunk + 1) * ESTIMATOR_CHUNK);
+        for (size_t i = chunk * ESTIMATOR_CHUNK; i < end; i++) {
+            double prob = sample(rng, drawn[i].pt_prob);
+            drawn[i].weight = 1.0 / (n * prob);
+        }
+    }
+    sort(drawn.begin(), drawn.end(), [](const sample_t &a, const sample_t &b) { return a.pt_prob > b.pt_prob; });
+
+    sorted_probs.resize(n);
+    cumulative_ranks.resize(n);
+    double rank = 0;
+    for (size_t i = 0; i < n; i++) {
+        rank += drawn[i].weight;
+        sorted_probs[i] = drawn[i].pt_prob;
+        cumulative_ranks[i] = rank;
+    }
+}
+
+/**
+ * estimate: 估计一个口令的概率和猜测序号
+ * 与 model::parse 相同，按字母 / 数字 / 其他字符把口令切分为连续的 segment
+ * 猜测序号 = 所在 PT 之前的猜测数（采样估计）+ 口令在 PT 中的位置：
+ * 前缀按行编号（与 BuildPrefixes 相同，各前缀 segment 的类内偏移构成混合进制数，最后一个前缀 segment 变化最快），
+ * 每行依次接最后一个 segment 的全部 value
+ * @param pw 口令
+ * @param[out] rank 估计的猜测序号，模型生成不了该口令时为 -1
+ * @return 概率，模型生成不了该口令时为 0
+ */
+double GuessEstimator::estimate(const string &pw, double &rank) const
+{
+    rank = -1;
+    vector<string> parts;
+    vector<int> types;
+    string pattern;
+    for (char ch : pw) {
+        int type = isalpha(ch) ? 1 : (isdigit(ch) ? 2 : 3);
+        if (types.empty() || types.back() != type) {
+            types.push_back(type);
+            parts.emplace_back();
+        }
+        parts.back() += ch;
+    }
+    for (size_t k = 0; k < parts.size(); k++) {
+        pattern += (types[k] == 1) ? "L" : (types[k] == 2 ? "D" : "S");
+        pattern += to_string(parts[k].size());
+    }
+
+    auto root = root_index.find(pattern);
+    if (root == root_index.end()) {
+        return 0;
+    }
+    const PT &pt = roots[root->second];
+    size_t last = parts.size() - 1;
+    double prob = pt.preterm_prob;
+    double pt_prob = 0;
+    double row = 0;
+    for (size_t k = 0; k <= last; k++) {
+        const segTable_t &table = tables[types[k] - 1][pt.seg_ids[k]];
+        auto value = table.value_index.find(parts[k]);
+        if (value == table.value_index.end()) {
+            return 0;
+        }
+        int i = value->second;
+        int c = upper_bound(table.class_starts.begin(), table.class_starts.end(), i) - table.class_starts.begin() - 1;
+        if (k == last) {
+            pt_prob = prob * table.class_probs[0];
+            row = row * table.class_starts.back() + i;
+        } else {
+            row = row * (table.class_starts[c + 1] - table.class_starts[c]) + (i - table.class_starts[c]);
+        }
+        prob *= table.class_probs[c];
+    }
+
+    // sorted_probs 降序，找到第一个所在 PT 的概率不高于 pt_prob 的采样
+    size_t k = lower_bound(sorted_probs.begin(), sorted_probs.end(), pt_prob, greater<double>()) - sorted_probs.begin();
+    rank = (k == 0 ? 0 : cumulative_ranks[k - 1]) + row;
+    return prob;
+}
+
+/**
+ * estimateAll: 批量估计一组口令的概率和猜测序号，各线程处理不同的口令
+ * @param pws 口令
+ * @param[out] probs 各口令的概率
+ * @param[out] ranks 各口令的估计猜测序号
+ * @param threads 线程数
+ */
+void GuessEstimator::estimateAll(const vector<string> &pws, vector<double> &probs, vector<double> &ranks, int threads) const
+{
+    probs.resize(pws.size());
+    ranks.resize(pws.size());
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (size_t i = 0; i < pws.size(); i++) {
+        probs[i] = estimate(pws[i], ranks[i]);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "PCFG.h"
+
+using namespace std;
+
+// 默认的采样数：估计的相对误差约为 O(1 / sqrt(采样数))
+#define ESTIMATOR_SAMPLES 1000000
+
+// 采样按块进行，每块使用由种子和块号确定的随机数序列，结果与线程数无关
+#define ESTIMATOR_CHUNK 65536
+
+// 猜测序号估计器（蒙特卡洛方法）：
+// 队列每次展开一个 PT：前缀 segment 各取一个 value 类，最后一个 segment 取全部 value，这些猜测按 PT 的概率
+// （最后一个 segment 取最高的 value 概率）一起输出。因此一个口令的猜测序号 ≈ 概率高于其所在 PT 的所有 PT 的猜测总数
+// + 口令在本 PT 中的位置。前者用重要性采样估计：从模型中按 PT 和 value 的概率独立采样 n 个猜测，
+// 第 i 个猜测的概率为 q_i、所在 PT 的概率为u_i，则 sum_{u_i > u} 1 / (n * q_i) 是概率高于 u 的 PT 中猜测总数的无偏估计。
+// 采样按 u_i 降序排列并预先累加权重，单个口令的估计只需一次二分查找（微秒级）
+class GuessEstimator
+{
+public:
+    // 由已经 init 的优先队列（队列中为全部初始 PT）建立估计器：采样 n 个猜测的概率，建立排名表
+    void build(PriorityQueue &q, size_t n, unsigned long long seed, int threads);
+
+    // 估计一个口令：按 model::parse 的规则切分，返回口令在模型下的概率（PT 的概率乘以各 segment 中 value 的概率），
+    // rank 为估计的猜测序号（从 0 开始）；模型生成不了该口令（PT 或某个 value 没有出现过）时概率为 0，rank 为 -1
+    double estimate(const string &pw, double &rank) const;
+
+    // 批量估计，多线程
+    void estimateAll(const vector<string> &pws, vector<double> &probs, vector<double> &ranks, int threads) const;
+
+    size_t samples() const { return sorted_probs.size(); }
+
+private:
+    // 一个 segment（如 L6）的采样和查询表
+    struct segTable_t {
+        vector<double> class_cdf;                   // value 类的累积概率（类的概率 = 单个 value 的概率 × 类的大小）
+        vector<float> class_probs;                  // 类中单个 value 的概率
+        vector<int> class_starts;                   // 各类第一个 value 的下标，末尾为 value 总数
+        unordered_map<string, int> value_index;     // value -> 在 value 表中的下标
+    };
+
+    // 一个采样：所在 PT 的概率和权重 1 / (n * 猜测的概率)
+    struct sample_t {
+        double pt_prob;
+        double weight;
+    };
+
+    // 建立某一类 segment 的表
+    void buildTables(vector<segment> &segs, vector<segTable_t> &tables);
+
+    // 采样一个猜测，返回其概率，pt_prob 为其所在 PT 的概率
+    template <typename Rng>
+    double sample(Rng &rng, double &pt_prob) const;
+
+    vector<segTable_t> tables[3];       // 依次为 letters / digits / symbols，下标与模型中相同
+    vector<PT> roots;                   // 各初始 PT（记录了 content 和 seg_ids）
+    vector<double> root_cdf;            // 初始 PT 的累积概率
+    unordered_map<string, int> root_index;  // PT 的结构（如 "L6D1"）-> roots 中的下标
+
+    vector<double> sorted_probs;        // 采样所在 PT 的概率，降序
+    vector<double> cumulative_ranks;    // cumulative_ranks[k] 为前 k + 1 个采样的权重之和
+};
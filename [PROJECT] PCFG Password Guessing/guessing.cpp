@@ -1,4 +1,5 @@
 #include "PCFG.h"
+#include "comm.h"
 using namespace std;
 
 // 互斥锁，保护从猜测列表的读和写操作
@@ -16,45 +17,51 @@ void PriorityQueue::CalProb(PT &pt) {
 
     // 计算一个PT本身的概率。后续所有具体segment value的概率，直接累乘在这个初始概率值上
     pt.prob = pt.preterm_prob;
+    pt.log_prob = log(double(pt.preterm_prob));
 
     // index: 标注当前segment在PT中的位置
     int index = 0;
 
-
     for (int idx : pt.curr_indices)
     {
-        // pt.content[index].PrintSeg();
-        if (pt.content[index].type == 1)
-        {
-            // 下面这行代码的意义：
-            // pt.content[index]：目前需要计算概率的segment
-            // m.FindLetter(seg): 找到一个letter segment在模型中的对应下标
-            // m.letters[m.FindLetter(seg)]：一个letter segment在模型中对应的所有统计数据
-            // m.letters[m.FindLetter(seg)].ordered_values：一个letter segment在模型中，所有value的总数目
-            pt.prob *= m.letters[m.FindLetter(pt.content[index])].ordered_freqs[idx];
-            pt.prob /= m.letters[m.FindLetter(pt.content[index])].total_freq;
-            // cout << m.letters[m.FindLetter(pt.content[index])].ordered_freqs[idx] << endl;
-            // cout << m.letters[m.FindLetter(pt.content[index])].total_freq << endl;
-        }
-        if (pt.content[index].type == 2)
-        {
-            pt.prob *= m.digits[m.FindDigit(pt.content[index])].ordered_freqs[idx];
-            pt.prob /= m.digits[m.FindDigit(pt.content[index])].total_freq;
-            // cout << m.digits[m.FindDigit(pt.content[index])].ordered_freqs[idx] << endl;
-            // cout << m.digits[m.FindDigit(pt.content[index])].total_freq << endl;
-        }
-        if (pt.content[index].type == 3)
-        {
-            pt.prob *= m.symbols[m.FindSymbol(pt.content[index])].ordered_freqs[idx];
-            pt.prob /= m.symbols[m.FindSymbol(pt.content[index])].total_freq;
-            // cout << m.symbols[m.FindSymbol(pt.content[index])].ordered_freqs[idx] << endl;
-            // cout << m.symbols[m.FindSymbol(pt.content[index])].total_freq << endl;
-        }
+        // m.GetSegment(pt, index)：通过 init 时记录的 seg_ids，直接找到这个 segment 在模型中对应的统计数据
+        // class_probs[idx]：该 segment 第 idx 个 value 类中单个 value 的概率，已在模型训练完成后预计算
+        // （最后一个 segment 的 idx 恒为 0，第 0 类即概率最高的 value）
+        segment &seg = m.GetSegment(pt, index);
+        pt.prob *= seg.class_probs[idx];
+        pt.log_prob += seg.class_log_probs[idx];
         index += 1;
     }
+#if PROB_LOG_EXACT
+    pt.prob = exp(pt.log_prob);
+#endif
     // cout << pt.prob << endl;
 }
 
+/**
+ * CalChildProb: 增量计算子 PT 的概率
+ * 子 PT 由 NewPTs 生成，与父 PT 只在 pivot 位置的下标不同，因此
+ * 子 PT 概率 = 父 PT 概率 * p(新 value 类) / p(旧 value 类)，不需要遍历全部 segment 重新计算
+ * @param parent 父 PT（概率已计算）
+ * @param child 子 PT
+ */
+void PriorityQueue::CalChildProb(const PT &parent, PT &child) {
+    int i = child.pivot;
+    segment &seg = m.GetSegment(child, i);
+    int new_idx = child.curr_indices[i];
+    int old_idx = parent.curr_indices[i];
+
+    child.log_prob = parent.log_prob + seg.class_log_probs[new_idx] - seg.class_log_probs[old_idx];
+#if PROB_LOG_EXACT
+    // 精确模式：对数概率只做加减，不会像连乘连除一样累积 float 误差
+    child.prob = exp(child.log_prob);
+#else
+    // 新 value 的概率不会高于旧 value，但 float 先乘后除可能向上舍入一位，
+    // 这里截断到父 PT 的概率，保证子 PT 不会排到父 PT 之前
+    child.prob = min(parent.prob, parent.prob * seg.class_probs[new_idx] / seg.class_probs[old_idx]);
+#endif
+}
+
 void PriorityQueue::init() {
     // cout << m.ordered_pts.size() << endl;
     // 用所有可能的PT，按概率降序填满整个优先队列
@@ -62,23 +69,34 @@ void PriorityQueue::init() {
     {
         for (segment seg : pt.content)
         {
+            // 记录该 segment 在模型中的下标，后续直接通过 m.GetSegment 访问
             if (seg.type == 1)
             {
-                // 下面这行代码的意义：
-                // max_indices用来表示PT中各个segment的可能数目。例如，L6S1中，假设模型统计到了100个L6，那么L6对应的最大下标就是99
-                // （但由于后面采用了"<"的比较关系，所以其实max_indices[0]=100）
-                // m.FindLetter(seg): 找到一个letter segment在模型中的对应下标
-                // m.letters[m.FindLetter(seg)]：一个letter segment在模型中对应的所有统计数据
-                // m.letters[m.FindLetter(seg)].ordered_values：一个letter segment在模型中，所有value的总数目
-                pt.max_indices.emplace_back(m.letters[m.FindLetter(seg)].ordered_values.size());
+                pt.seg_ids.emplace_back(m.FindLetter(seg));
             }
             if (seg.type == 2)
             {
-                pt.max_indices.emplace_back(m.digits[m.FindDigit(seg)].ordered_values.size());
+                pt.seg_ids.emplace_back(m.FindDigit(seg));
             }
             if (seg.type == 3)
             {
-                pt.max_indices.emplace_back(m.symbols[m.FindSymbol(seg)].ordered_values.size());
+                pt.seg_ids.emplace_back(m.FindSymbol(seg));
+            }
+        }
+        for (size_t i = 0; i < pt.content.size(); i += 1)
+        {
+            // 下面这行代码的意义：
+            // max_indices用来表示PT中各个segment的可能数目。例如，L6S1中，假设模型统计到了100个L6，那么L6对应的最大下标就是99
+            // （但由于后面采用了"<"的比较关系，所以其实max_indices[0]=100）
+            // 除最后一个segment外，PT按value类推进，因此记录的是类的数目；最后一个segment记录value的总数目
+            segment &model_seg = m.GetSegment(pt, i);
+            if (i == pt.content.size() - 1)
+            {
+                pt.max_indices.emplace_back(model_seg.ValueCount());
+            }
+            else
+            {
+                pt.max_indices.emplace_back(model_seg.ClassCount());
             }
         }
         pt.preterm_prob = float(m.preterm_freq[m.FindPT(pt)]) / m.total_preterm;
@@ -87,57 +105,174 @@ void PriorityQueue::init() {
 
         // 计算当前pt的概率
         CalProb(pt);
+        // 子树的根：初始 PT 在 ordered_pts 中的下标
+        pt.root = priority.size();
         // 将PT放入优先队列
         priority.emplace_back(pt);
     }
+    // ordered_pts 只按 PT 本身的概率排序，乘上各 segment 最高 value 的概率之后顺序可能改变
+    // 这里按完整概率重新排序，保证队列从一开始就是降序的（InsertPT 依赖这一点）
+    stable_sort(priority.begin(), priority.end(),
+                [](const PT &a, const PT &b) { return a.prob > b.prob; });
     // cout << "priority size:" << priority.size() << endl;
 }
 
+/**
+ * InsertPT: 按概率将新的 PT 插入优先队列
+ * 队列按概率降序排列，二分查找第一个概率严格小于新 PT 的位置，概率相同的 PT 按先后顺序排列
+ * 队首是正在出队的 PT，不参与比较
+ * @param pt 新的 PT（概率已计算）
+ */
+void PriorityQueue::InsertPT(const PT &pt) {
+    auto iter = upper_bound(priority.begin() + 1, priority.end(), pt,
+                            [](const PT &a, const PT &b) { return a.prob > b.prob; });
+    priority.emplace(iter, pt);
+}
+
 void PriorityQueue::PopNext() {
 
+    // 第一次展开前，确定是否对该 PT 进行块展开
+    if (priority.front().gen_offset == 0)
+    {
+        PlanBlock(priority.front());
+    }
+
+    RecordSpan(priority.front());
+
     // 对优先队列最前面的PT，首先利用这个PT生成一系列猜测
-    // <=== 串行方法 ===>
-    // Generate(priority.front());
-    // <= pthread 方法 =>
-    // PthreadGenerate(priority.front());
-    // PthreadPoolGenerate(priority.front());
-    // <== openmp 方法 =>
-    // OpenMPGenerate(priority.front());
-    // <=== MPI方法 ===>
-    // MPIGenerate(priority.front());
-    // <=== MPI+方法 ==>
-    MPIplusOpenMPGenerate(priority.front());
+    // 具体使用哪种方法（串行 / pthread / 线程池 / openmp / MPI / MPI+ / 自适应）由 backend 决定
+    (this->*gen_backends[backend].func)(priority.front());
+
+    FinishFront();
+}
+
+/**
+ * PopBatch: 按当前生成方法展开一批 PT
+ * openmp_persistent 一次连续处理多个 PT；其余方法（以及需要逐个 PT 推进的 DistributedStep 等）只展开队首一个 PT
+ * @param target openmp_persistent 本批至少生成的猜测数
+ */
+void PriorityQueue::PopBatch(long long target) {
+    if (backend == GEN_OPENMP_PERSISTENT) {
+        OpenMPPersistentGenerate(target);
+    }
+    else {
+        PopNext();
+    }
+}
+
+/**
+ * RecordSpan: 记录一个 PT 即将展开，此后追加到 guesses 中的猜测都来自这个 PT（直到下一次记录）
+ * 各生成方法都只在 guesses 末尾追加，因此记录展开前的 guesses.size() 即可
+ * @param pt 即将展开的 PT
+ */
+void PriorityQueue::RecordSpan(const PT &pt) {
+    GuessSpan span;
+    span.first = guesses.size();
+    span.pattern = pt.Pattern();
+    span.curr_indices = pt.curr_indices;
+    span.gen_offset = pt.gen_offset;
+    spans.push_back(span);
+}
+
+/**
+ * FindSpan: 查找 guesses[index] 所属的来源记录
+ * spans 按 first 递增，二分查找最后一个 first <= index 的记录
+ * @param index 猜测在 guesses 中的下标
+ * @return 来源记录，找不到时返回 NULL
+ */
+const GuessSpan *PriorityQueue::FindSpan(size_t index) const {
+    auto iter = upper_bound(spans.begin(), spans.end(), index,
+                            [](size_t i, const GuessSpan &span) { return i < span.first; });
+    if (iter == spans.begin()) {
+        return NULL;
+    }
+    return &*(iter - 1);
+}
+
+/**
+ * ClearGuesses: 清空已生成的猜测，来源记录随之失效，一并清空，猜测计数归零
+ */
+void PriorityQueue::ClearGuesses() {
+    guesses.clear();
+    spans.clear();
+    total_guesses = 0;
+}
+
+/**
+ * TruncateGuesses: 只保留前 n 个已生成的猜测，其后的猜测及其来源记录丢弃
+ * @param n 保留的猜测数（不超过当前猜测数）
+ */
+void PriorityQueue::TruncateGuesses(size_t n) {
+    if (n >= guesses.size()) {
+        return;
+    }
+    total_guesses -= guesses.size() - n;
+    guesses.resize(n);
+    while (!spans.empty() && spans.back().first >= n) {
+        spans.pop_back();
+    }
+}
+
+/**
+ * SkipGuesses: 快进，跳过按概率顺序的接下来 n 个猜测，不生成它们
+ * 与 PopNext 的顺序完全相同：依次对队首 PT 做块展开规划、由 GuessCount 得到其剩余猜测数，
+ * 整个 PT 都被跳过时直接推进到展开完毕（生成子 PT 并出队）；跳过的终点落在某个 PT 中间时，
+ * 只推进它的 gen_offset，此后的展开从终点处开始。同一个 PT 的猜测总是连续地按序号生成，
+ * 各次展开的分界位置不影响输出顺序，因此之后生成的猜测与不跳过时第 n 个之后的猜测完全相同
+ * @param n 要跳过的猜测数
+ * @return 实际跳过的猜测数（队列耗尽时小于 n）
+ */
+long long PriorityQueue::SkipGuesses(long long n) {
+    long long skipped = 0;
+    while (skipped < n && !priority.empty()) {
+        PT &front = priority.front();
+        if (front.gen_offset == 0) {
+            PlanBlock(front);
+        }
+        long long remaining = GuessCount(front) - front.gen_offset;
+        if (skipped + remaining > n) {
+            front.gen_offset += n - skipped;
+            return n;
+        }
+        skipped += remaining;
+        front.gen_offset = GuessCount(front);
+        FinishFront();
+    }
+    return skipped;
+}
+
+/**
+ * Partitioned: 当前生成方法是否按 RankRange 把每个 PT 的猜测划分给各进程
+ * 是：total_guesses 已经是所有进程的合计；否：每个进程都生成全部猜测，合计为 total_guesses * 进程数
+ * openmp_persistent 与 openmp 一样在本地生成全部猜测，不划分
+ */
+bool PriorityQueue::Partitioned() const {
+    return backend == GEN_MPI || backend == GEN_MPI_OPENMP;
+}
+
+/**
+ * FinishFront: 队首 PT 本次展开之后的善后工作
+ * 推进 gen_offset；PT 的猜测全部展开完毕时，生成子 PT 插入队列，并将其出队
+ */
+void PriorityQueue::FinishFront() {
+    // 猜测数过多的 PT 每次只展开 MAX_BATCH_GUESSES 个猜测，没有展开完时留在队首，下次继续
+    PT &front = priority.front();
+    front.gen_offset = min(GuessCount(front), front.gen_offset + MAX_BATCH_GUESSES);
+    if (front.gen_offset < GuessCount(front))
+    {
+        return;
+    }
 
     // 然后需要根据即将出队的PT，生成一系列新的PT
     vector<PT> new_pts = priority.front().NewPTs();
     for (PT pt : new_pts)
     {
-        // 计算概率
-        CalProb(pt);
-        // 接下来的这个循环，作用是根据概率，将新的PT插入到优先队列中
-        for (auto iter = priority.begin(); iter != priority.end(); iter++)
-        {
-            // 对于非队首和队尾的特殊情况
-            if (iter != priority.end() - 1 && iter != priority.begin())
-            {
-                // 判定概率
-                if (pt.prob <= iter->prob && pt.prob > (iter + 1)->prob)
-                {
-                    priority.emplace(iter + 1, pt);
-                    break;
-                }
-            }
-            if (iter == priority.end() - 1)
-            {
-                priority.emplace_back(pt);
-                break;
-            }
-            if (iter == priority.begin() && iter->prob < pt.prob)
-            {
-                priority.emplace(iter, pt);
-                break;
-            }
-        }
+        // 计算概率：由队首 PT 的概率增量得到
+        CalChildProb(priority.front(), pt);
+        pt.gen_offset = 0;
+        pt.block_len = 1;
+        // 根据概率，将新的PT插入到优先队列中
+        InsertPT(pt);
     }
 
     // 现在队首的PT善后工作已经结束，将其出队（删除）
@@ -168,7 +303,9 @@ vector<PT> PT::NewPTs() {
         for (int i = pivot; i < curr_indices.size() - 1; i += 1)
         {
             // curr_indices: 标记各segment目前的value在模型里对应的下标
-            curr_indices[i] += 1;
+            // 块展开时，倒数第二个segment的block_len个value类已经一起生成，直接跳到块之后
+            int step = (i == (int)curr_indices.size() - 2) ? block_len : 1;
+            curr_indices[i] += step;
 
             // max_indices：标记各segment在模型中一共有多少个value
             if (curr_indices[i] < max_indices[i])
@@ -179,7 +316,7 @@ vector<PT> PT::NewPTs() {
             }
 
             // 这个步骤对于你理解pivot的作用、新PT生成的过程而言，至关重要
-            curr_indices[i] -= 1;
+            curr_indices[i] -= step;
         }
         pivot = init_pivot;
         return res;
@@ -188,100 +325,187 @@ vector<PT> PT::NewPTs() {
     return res;
 }
 
-// 这个函数是PCFG并行化算法的主要载体
-// 尽量看懂，然后进行并行实现
-void PriorityQueue::Generate(PT pt) {
-    // 计算PT的概率，这里主要是给PT的概率进行初始化
-    CalProb(pt);
+/**
+ * GuessCount: 计算一个 PT 展开后的猜测总数
+ * @param pt 目标 PT
+ * @return 各前缀 segment 当前 value 类的大小之积 × 最后一个 segment 的 value 数
+ */
+long long PriorityQueue::GuessCount(const PT &pt) {
+    int last = pt.content.size() - 1;
+    long long count = pt.max_indices[last];
+    for (int i = 0; i < last; i += 1)
+    {
+        segment &seg = m.GetSegment(pt, i);
+        int c = pt.curr_indices[i];
+        int c_end = (i == last - 1) ? c + pt.block_len : c + 1;
+        count *= seg.class_starts[c_end] - seg.class_starts[c];
+    }
+    return count;
+}
 
-    // 对于只有一个segment的PT，直接遍历生成其中的所有value即可
-    if (pt.content.size() == 1)
+/**
+ * PlanBlock: 块展开，把倒数第二个 segment 的若干个后续 value 类并入本次展开
+ * 最后一个 segment 的 value 很少时（例如只有几十个取值的 S1），单个 PT 生成的猜测太少，
+ * 不足以摊薄线程/SIMD 的启动开销。此时把倒数第二个 segment 从当前类开始的连续几个类一起展开，
+ * 即一次生成 "倒数第二个 segment 的一段 value × 最后一个 segment 的全部 value" 这一矩形区域。
+ * 块内的类概率不低于当前类的 BLOCK_PROB_RATIO 倍，块的大小以达到 BLOCK_MIN_BATCH 个猜测为止。
+ * 被并入的类不会再由子 PT 生成（NewPTs 在该 segment 上直接跳过整个块），因此覆盖仍然是精确的，
+ * 但块内后续类的猜测比按概率排序时提前输出，队列不再严格按概率降序。BLOCK_EXPANSION 为 0（默认）时 block_len 恒为 1。
+ * @param pt 即将出队的 PT
+ */
+void PriorityQueue::PlanBlock(PT &pt) {
+    pt.block_len = 1;
+#if BLOCK_EXPANSION
+    if (pt.content.size() < 2)
     {
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        // 在模型中定位到这个segment
-        if (pt.content[0].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[0])];
-        }
-        if (pt.content[0].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[0])];
-        }
-        if (pt.content[0].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[0])];
-        }
+        return;
+    }
+    int i = pt.content.size() - 2;
+    segment &seg = m.GetSegment(pt, i);
+    int c = pt.curr_indices[i];
+
+    // 倒数第二个 segment 每个 value 对应的猜测数
+    long long per_value = GuessCount(pt) / (seg.class_starts[c + 1] - seg.class_starts[c]);
+    while (c + pt.block_len < pt.max_indices[i]
+           && per_value * (seg.class_starts[c + pt.block_len] - seg.class_starts[c]) < BLOCK_MIN_BATCH
+           && seg.class_probs[c + pt.block_len] >= seg.class_probs[c] * BLOCK_PROB_RATIO)
+    {
+        pt.block_len += 1;
+    }
+#endif
+}
 
-        // Multi-thread TODO：
-        // 这个for循环就是你需要进行并行化的主要部分了，特别是在多线程&GPU编程任务中
-        // 可以看到，这个循环本质上就是把模型中一个segment的所有value，赋值到PT中，形成一系列新的猜测
-        // 这个过程是可以高度并行化的
-        for (int i = 0; i < pt.max_indices[0]; i += 1)
-        {
-            string guess = a->ordered_values[i];
-            // cout << guess << endl;
-            guesses.emplace_back(guess);
-            total_guesses += 1;
-        }
+/**
+ * BuildPrefixes: 生成 PT 的前缀（除最后一个 segment 以外，所有 segment 的 value 拼接）
+ * 每个前缀 segment 取其当前 value 类（块展开时为一段连续的类）中的所有 value，PT 的前缀就是这些 value 的全部组合
+ * 前缀按行编号，最后一个前缀 segment 变化最快
+ * @param pt 目标 PT
+ * @param row_begin 起始行号
+ * @param row_end 结束行号（不含）
+ * @param[out] prefixes 生成的前缀，prefixes[0] 对应第 row_begin 行
+ */
+void PriorityQueue::BuildPrefixes(const PT &pt, long long row_begin, long long row_end, vector<string> &prefixes) {
+    int n = pt.content.size() - 1;
+    vector<segment*> segs(n);
+    vector<int> starts(n), sizes(n), digits(n);
+    for (int i = 0; i < n; i += 1)
+    {
+        segs[i] = &m.GetSegment(pt, i);
+        int c = pt.curr_indices[i];
+        // 倒数第二个 segment 在块展开时覆盖 block_len 个连续的类，这些类的 value 在 value 表中也是连续的
+        int c_end = (i == n - 1) ? c + pt.block_len : c + 1;
+        starts[i] = segs[i]->class_starts[c];
+        sizes[i] = segs[i]->class_starts[c_end] - starts[i];
     }
-    else
+
+    // 将起始行号展开为各前缀 segment 的类内偏移（混合进制）
+    long long r = row_begin;
+    for (int i = n - 1; i >= 0; i -= 1)
+    {
+        digits[i] = r % sizes[i];
+        r /= sizes[i];
+    }
+
+    prefixes.clear();
+    prefixes.reserve(row_end - row_begin);
+    for (long long row = row_begin; row < row_end; row += 1)
     {
-        string guess;
-        int seg_idx = 0;
-        // 这个for循环的作用：给当前PT的所有segment赋予实际的值（最后一个segment除外）
-        // segment值根据curr_indices中对应的值加以确定
-        // 这个for循环你看不懂也没太大问题，并行算法不涉及这里的加速
-        for (int idx : pt.curr_indices)
+        string prefix;
+        for (int i = 0; i < n; i += 1)
         {
-            if (pt.content[seg_idx].type == 1)
-            {
-                guess += m.letters[m.FindLetter(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 2)
-            {
-                guess += m.digits[m.FindDigit(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 3)
-            {
-                guess += m.symbols[m.FindSymbol(pt.content[seg_idx])].ordered_values[idx];
-            }
-            seg_idx += 1;
-            if (seg_idx == pt.content.size() - 1)
+            prefix.append(segs[i]->ValueData(starts[i] + digits[i]), segs[i]->ValueLength(starts[i] + digits[i]));
+        }
+        prefixes.emplace_back(prefix);
+
+        // 类内偏移逐行进位
+        for (int i = n - 1; i >= 0; i -= 1)
+        {
+            digits[i] += 1;
+            if (digits[i] < sizes[i])
             {
                 break;
             }
+            digits[i] = 0;
         }
+    }
+}
 
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        if (pt.content[pt.content.size() - 1].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[pt.content.size() - 1])];
-        }
+/**
+ * PrepareJob: 为 PT 的本次展开准备生成任务
+ * 从 pt.gen_offset 开始，至多展开 MAX_BATCH_GUESSES 个猜测，只生成该区间覆盖到的前缀
+ * @param pt 目标 PT
+ * @param[out] job 生成任务
+ */
+void PriorityQueue::PrepareJob(const PT &pt, GuessJob &job) {
+    PrepareRange(pt, pt.gen_offset, min(GuessCount(pt), pt.gen_offset + MAX_BATCH_GUESSES), job);
+}
+
+/**
+ * PrepareRange: 为 PT 的猜测区间 [begin, end) 准备生成任务
+ * @param pt 要展开的 PT
+ * @param begin 起点（以 PT 内的猜测序号计）
+ * @param end 终点（不含）
+ * @param[out] job 生成任务
+ */
+void PriorityQueue::PrepareRange(const PT &pt, long long begin, long long end, GuessJob &job) {
+    int last = pt.content.size() - 1;
+    job.last = &m.GetSegment(pt, last);
+    job.width = pt.max_indices[last];
+    job.begin = begin;
+    job.end = end;
+    job.row_begin = job.begin / job.width;
+    BuildPrefixes(pt, job.row_begin, (job.end - 1) / job.width + 1, job.prefixes);
+}
 
-        // Multi-thread TODO：
-        // 这个for循环就是你需要进行并行化的主要部分了，特别是在多线程&GPU编程任务中
-        // 可以看到，这个循环本质上就是把模型中一个segment的所有value，赋值到PT中，形成一系列新的猜测
-        // 这个过程是可以高度并行化的
-        for (int i = 0; i < pt.max_indices[pt.content.size() - 1]; i += 1)
+/**
+ * FillGuesses: 将生成任务中 [start, end) 区间的猜测依次写入 out
+ * 各种并行方法都只需要划分区间，再调用这个函数即可
+ * @param job 生成任务
+ * @param start 起点（以 PT 内的猜测序号计）
+ * @param end 终点（不含）
+ * @param[out] out 输出位置，out[0] 对应第 start 个猜测
+ */
+void FillGuesses(const GuessJob &job, long long start, long long end, string *out) {
+    if (start >= end)
+    {
+        return;
+    }
+    long long row = start / job.width;
+    long long col = start % job.width;
+    const segment *last = job.last;
+    for (long long g = start; g < end; g += 1)
+    {
+        // 直接在输出位置上拼接前缀和 value（value 表可能位于节点共享的模型镜像中）
+        string &guess = *out++;
+        guess.assign(job.prefixes[row - job.row_begin]);
+        guess.append(last->ValueData(col), last->ValueLength(col));
+        col += 1;
+        if (col == job.width)
         {
-            string temp = guess + a->ordered_values[i];
-            // cout << temp << endl;
-            guesses.emplace_back(temp);
-            total_guesses += 1;
+            col = 0;
+            row += 1;
         }
     }
 }
 
+// 这个函数是PCFG并行化算法的主要载体
+// 尽量看懂，然后进行并行实现
+void PriorityQueue::Generate(PT pt) {
+    // 准备生成任务：PT 的所有猜测 = 前缀 × 最后一个 segment 的所有 value
+    // 对于只有一个segment的PT，前缀只有一个空串
+    GuessJob job;
+    PrepareJob(pt, job);
+
+    // Multi-thread TODO：
+    // 这个for循环就是你需要进行并行化的主要部分了，特别是在多线程&GPU编程任务中
+    // 可以看到，这个循环本质上就是把模型中一个segment的所有value，赋值到PT中，形成一系列新的猜测
+    // 这个过程是可以高度并行化的
+    size_t base = guesses.size();
+    guesses.resize(base + (job.end - job.begin));
+    FillGuesses(job, job.begin, job.end, guesses.data() + base);
+    total_guesses += job.end - job.begin;
+}
+
 // ===== pthread 相关实现（无线程池） ===== //
 
 /**
@@ -291,30 +515,24 @@ void PriorityQueue::Generate(PT pt) {
 void* threadFunc(void* param) {
     threadParam_t* p = (threadParam_t*) param;
     int t_id = p->t_id;
-    segment* a = p->a;
-    int max_index = p->max_index;
-    string guess = p->init_guess;
+    GuessJob* job = p->job;
 
-    vector<string> my_guesses;
-    int my_count = 0;
-    int chunk_size = (max_index + NUM_THREADS - 1) / NUM_THREADS;
+    long long work = job->end - job->begin;
+    long long chunk_size = (work + NUM_THREADS - 1) / NUM_THREADS;
     if (chunk_size == 0) {
         chunk_size = 1;
     }
-    int start = t_id * chunk_size;
-    int end = min(max_index, start + chunk_size);
+    long long start = min(job->end, job->begin + t_id * chunk_size);
+    long long end = min(job->end, start + chunk_size);
 
-    for (int my_index = start; my_index < end; my_index++) {
-        // 执行任务
-        string temp = guess + a->ordered_values[my_index];
-        my_guesses.emplace_back(temp);
-        my_count++;
-    }
+    // 执行任务
+    vector<string> my_guesses(end - start);
+    FillGuesses(*job, start, end, my_guesses.data());
 
     // 临界区：结果写入猜测序列
     pthread_mutex_lock(&mutex_guess);
     p->guesses->insert(p->guesses->end(), my_guesses.begin(), my_guesses.end());
-    *(p->total_guesses) += my_count;
+    *(p->total_guesses) += my_guesses.size();
     pthread_mutex_unlock(&mutex_guess);
 
     pthread_exit(NULL);
@@ -325,127 +543,34 @@ void* threadFunc(void* param) {
  * @param pt 生成用的原 pt
  */
 void PriorityQueue::PthreadGenerate(PT pt) {
-    // 计算PT的概率，这里主要是给PT的概率进行初始化
-    CalProb(pt);
-
-    // 对于只有一个segment的PT，直接遍历生成其中的所有value即可
-    if (pt.content.size() == 1)
-    {
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        // 在模型中定位到这个segment
-        if (pt.content[0].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[0])];
-        }
-        if (pt.content[0].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[0])];
-        }
-        if (pt.content[0].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[0])];
-        }
+    GuessJob job;
+    PrepareJob(pt, job);
 
-        // pthread
-        pthread_t handles[NUM_THREADS];
-        threadParam_t params[NUM_THREADS];
-
-        // 初始化锁
-        pthread_mutex_init(&mutex_guess, NULL);
-
-        for (int t_id = 0; t_id < NUM_THREADS; t_id++) {
-            // 初始化传入参数
-            params[t_id].t_id = t_id;
-            params[t_id].a = a;
-            params[t_id].max_index = pt.max_indices[0];
-            params[t_id].guesses = &guesses;
-            params[t_id].total_guesses = &total_guesses;
-            params[t_id].init_guess = "";
-
-            // 开启线程
-            pthread_create(&handles[t_id], NULL, threadFunc, (void*)&params[t_id]);
-        }
+    // pthread
+    pthread_t handles[NUM_THREADS];
+    threadParam_t params[NUM_THREADS];
 
-        // 等待所有线程完成
-        for (int t_id = 0; t_id < NUM_THREADS; t_id++) {
-            pthread_join(handles[t_id], NULL);
-        }
+    // 初始化锁
+    pthread_mutex_init(&mutex_guess, NULL);
 
-        // 清理互斥锁
-        pthread_mutex_destroy(&mutex_guess);
+    for (int t_id = 0; t_id < NUM_THREADS; t_id++) {
+        // 初始化传入参数
+        params[t_id].t_id = t_id;
+        params[t_id].job = &job;
+        params[t_id].guesses = &guesses;
+        params[t_id].total_guesses = &total_guesses;
+
+        // 开启线程
+        pthread_create(&handles[t_id], NULL, threadFunc, (void*)&params[t_id]);
     }
-    else
-    {
-        string guess;
-        int seg_idx = 0;
-        // 这个for循环的作用：给当前PT的所有segment赋予实际的值（最后一个segment除外）
-        // segment值根据curr_indices中对应的值加以确定
-        // 这个for循环你看不懂也没太大问题，并行算法不涉及这里的加速
-        for (int idx : pt.curr_indices)
-        {
-            if (pt.content[seg_idx].type == 1)
-            {
-                guess += m.letters[m.FindLetter(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 2)
-            {
-                guess += m.digits[m.FindDigit(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 3)
-            {
-                guess += m.symbols[m.FindSymbol(pt.content[seg_idx])].ordered_values[idx];
-            }
-            seg_idx += 1;
-            if (seg_idx == pt.content.size() - 1)
-            {
-                break;
-            }
-        }
-
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        if (pt.content[pt.content.size() - 1].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[pt.content.size() - 1])];
-        }
-
-        // pthread
-        pthread_t handles[NUM_THREADS];
-        threadParam_t params[NUM_THREADS];
-
-        // 初始化锁
-        pthread_mutex_init(&mutex_guess, NULL);
 
-        for (int t_id = 0; t_id < NUM_THREADS; t_id++) {
-            // 初始化传入参数
-            params[t_id].t_id = t_id;
-            params[t_id].a = a;
-            params[t_id].max_index = pt.max_indices[pt.content.size() - 1];
-            params[t_id].guesses = &guesses;
-            params[t_id].total_guesses = &total_guesses;
-            params[t_id].init_guess = guess;
-
-            // 开启线程
-            pthread_create(&handles[t_id], NULL, threadFunc, (void*)&params[t_id]);
-        }
-
-        // 等待所有线程完成
-        for (int t_id = 0; t_id < NUM_THREADS; t_id++) {
-            pthread_join(handles[t_id], NULL);
-        }
-
-        // 清理互斥锁
-        pthread_mutex_destroy(&mutex_guess);
+    // 等待所有线程完成
+    for (int t_id = 0; t_id < NUM_THREADS; t_id++) {
+        pthread_join(handles[t_id], NULL);
     }
+
+    // 清理互斥锁
+    pthread_mutex_destroy(&mutex_guess);
 }
 
 // ======================================= //
@@ -455,14 +580,14 @@ void PriorityQueue::PthreadGenerate(PT pt) {
 /**
  * ThreadPool: 线程池初始化构造函数
  */
-ThreadPool::ThreadPool() : threads(), tasks(), active_tasks(0), terminate(false) {
+ThreadPool::ThreadPool(int num_threads) : threads(), tasks(), active_tasks(0), terminate(false) {
     // 初始化锁和条件变量
     pthread_cond_init(&active_cond, NULL);
     pthread_cond_init(&alldone_cond, NULL);
     pthread_mutex_init(&task_mutex, NULL);
-    threads.resize(NUM_THREADS);
+    threads.resize(num_threads);
     // 创建静态线程
-    for (int t_id = 0; t_id < NUM_THREADS; t_id++) {
+    for (int t_id = 0; t_id < num_threads; t_id++) {
         pthread_create(&threads[t_id], NULL, &ThreadPool::threadFunction, this);
     }
 }
@@ -549,10 +674,8 @@ void* ThreadPool::threadFunction(void* pool) {
 
         // 如果成功获取任务，处理该任务
         if (t_task.t_active) {
-            for (int i = t_task.t_start; i < t_task.t_end; i++) {
-                string guess = t_task.t_preguess + (*(t_task.shared_values))[i];
-                t_task.shared_guesses[i] = std::move(guess);
-            }
+            FillGuesses(*t_task.job, t_task.t_start, t_task.t_end,
+                        t_task.shared_guesses + (t_task.t_start - t_task.job->begin));
 
             // 当前任务完成，任务计数减量
             pthread_mutex_lock(&t_pool->task_mutex);
@@ -570,9 +693,9 @@ void* ThreadPool::threadFunction(void* pool) {
 /**
  * initThreadPool: 创建线程池
  */
-void initThreadPool() {
+void initThreadPool(int num_threads) {
     if (!thread_pool) {
-        thread_pool = new ThreadPool();
+        thread_pool = new ThreadPool(num_threads);
     }
 }
 
@@ -591,296 +714,152 @@ void deleteThreadPool() {
  * @param pt 生成用的原 pt
  */
 void PriorityQueue::PthreadPoolGenerate(PT pt) {
-    // 计算PT的概率，这里主要是给PT的概率进行初始化
-    CalProb(pt);
-
-    // 对于只有一个segment的PT，直接遍历生成其中的所有value即可
-    if (pt.content.size() == 1)
-    {
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        // 在模型中定位到这个segment
-        if (pt.content[0].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[0])];
-        }
-        if (pt.content[0].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[0])];
-        }
-        if (pt.content[0].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[0])];
-        }
+    GuessJob job;
+    PrepareJob(pt, job);
+
+    // pthread pool
+    long long batch_size = job.end - job.begin;
+
+    // 提高任务粒度阈值，减少小任务的并行开销
+    if (batch_size < pool_serial_threshold) {
+        // 直接使用串行处理
+        size_t base = guesses.size();
+        guesses.resize(base + batch_size);
+        FillGuesses(job, job.begin, job.end, guesses.data() + base);
+        total_guesses += batch_size;
+        return;
+    }
 
-        // pthread pool
-        int batch_size = pt.max_indices[0];
+    long long chunk_size = pool_chunk_size;
+    long long chunk_num = (batch_size + chunk_size - 1) / chunk_size;  // + chunk_size - 1 的目的是实现向上取整
 
-        // 提高任务粒度阈值，减少小任务的并行开销
-        if (batch_size < 100000) {
-            // 直接使用串行处理
-            for (int i = 0; i < batch_size; i++) {
-                guesses.push_back(a->ordered_values[i]);
-            }
-            total_guesses += batch_size;
-            return;
-        }
-        
-        int chunk_size = POOL_CHUNK_SIZE;
-        int chunk_num = (batch_size + chunk_size - 1) / chunk_size;  // + chunk_size - 1 的目的是实现向上取整
-
-        // 预分配避免频繁扩容
-        guesses.reserve(guesses.size() + batch_size);
-
-        // 所有任务共享结果 string 数组
-        string* shared_guesses = new string[batch_size];
-
-        // 划分任务并传递给线程池
-        for (int id = 0; id < chunk_num; id++) {
-            int start = id * chunk_size;
-            int end = min(batch_size, start + chunk_size);
-
-            // 创建任务
-            threadTask_t task = {
-                start,
-                end,
-                "",
-                &a->ordered_values,
-                shared_guesses,
-                true
-            };
-
-            // 添加到任务队列
-            thread_pool->taskAppend(task);
-        }
+    // 预分配避免频繁扩容
+    guesses.reserve(guesses.size() + batch_size);
 
-        // 等待所有任务完成
-        thread_pool->waitAll();
+    // 所有任务共享结果 string 数组
+    string* shared_guesses = new string[batch_size];
 
-        // 结果拷贝到全局 guesses 中
-        for (int g_id = 0; g_id < batch_size; g_id++) {
-            guesses.push_back(std::move(shared_guesses[g_id]));
-        }
+    // 划分任务并传递给线程池
+    for (long long id = 0; id < chunk_num; id++) {
+        long long start = job.begin + id * chunk_size;
+        long long end = min(job.end, start + chunk_size);
 
-        // 全局猜测结果计数器增量
-        total_guesses += batch_size;
+        // 创建任务
+        threadTask_t task = {
+            start,
+            end,
+            &job,
+            shared_guesses,
+            true
+        };
 
-        // 回收分配资源
-        delete[] shared_guesses;
+        // 添加到任务队列
+        thread_pool->taskAppend(task);
     }
-    else
-    {
-        string guess;
-        int seg_idx = 0;
-        // 这个for循环的作用：给当前PT的所有segment赋予实际的值（最后一个segment除外）
-        // segment值根据curr_indices中对应的值加以确定
-        // 这个for循环你看不懂也没太大问题，并行算法不涉及这里的加速
-        for (int idx : pt.curr_indices)
-        {
-            if (pt.content[seg_idx].type == 1)
-            {
-                guess += m.letters[m.FindLetter(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 2)
-            {
-                guess += m.digits[m.FindDigit(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 3)
-            {
-                guess += m.symbols[m.FindSymbol(pt.content[seg_idx])].ordered_values[idx];
-            }
-            seg_idx += 1;
-            if (seg_idx == pt.content.size() - 1)
-            {
-                break;
-            }
-        }
-
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        if (pt.content[pt.content.size() - 1].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[pt.content.size() - 1])];
-        }
-
-        // pthread pool
-        int batch_size = pt.max_indices[pt.content.size() - 1];
-
-        // 提高任务粒度阈值，减少小任务的并行开销
-        if (batch_size < 100000) {
-            // 直接使用串行处理
-            for (int i = 0; i < batch_size; i++) {
-                guesses.push_back(guess + a->ordered_values[i]);
-            }
-            total_guesses += batch_size;
-            return;
-        }
-        
-        int chunk_size = POOL_CHUNK_SIZE;
-        int chunk_num = (batch_size + chunk_size - 1) / chunk_size;  // + chunk_size - 1 的目的是实现向上取整
-
-        // 预分配避免频繁扩容
-        guesses.reserve(guesses.size() + batch_size);
-
-        // 所有任务共享结果 string 数组
-        string* shared_guesses = new string[batch_size];
-
-        // 划分任务并传递给线程池
-        for (int id = 0; id < chunk_num; id++) {
-            int start = id * chunk_size;
-            int end = min(batch_size, start + chunk_size);
-
-            // 创建任务
-            threadTask_t task = {
-                start,
-                end,
-                guess,
-                &a->ordered_values,
-                shared_guesses,
-                true
-            };
-
-            // 添加到任务队列
-            thread_pool->taskAppend(task);
-        }
 
-        // 等待所有任务完成
-        thread_pool->waitAll();
+    // 等待所有任务完成
+    thread_pool->waitAll();
 
-        // 结果拷贝到全局 guesses 中
-        for (int g_id = 0; g_id < batch_size; g_id++) {
-            guesses.push_back(std::move(shared_guesses[g_id]));
-        }
+    // 结果拷贝到全局 guesses 中
+    for (long long g_id = 0; g_id < batch_size; g_id++) {
+        guesses.push_back(std::move(shared_guesses[g_id]));
+    }
 
-        // 全局猜测结果计数器增量
-        total_guesses += batch_size;
+    // 全局猜测结果计数器增量
+    total_guesses += batch_size;
 
-        // 回收分配资源
-        delete[] shared_guesses;
-    }
+    // 回收分配资源
+    delete[] shared_guesses;
 }
 
 // ======================================= //
 
 // =========== openmp 相关实现 =========== //
 
+/**
+ * ThreadRange: 将区间 [begin, end) 按线程数静态均分，求第 t_id 个线程负责的子区间
+ */
+static void ThreadRange(long long begin, long long end, int t_id, int num, long long &start, long long &stop) {
+    long long chunk = (end - begin + num - 1) / num;
+    start = min(end, begin + t_id * chunk);
+    stop = min(end, start + chunk);
+}
+
 /**
  * OpenMPGenerate: pt 生成猜测的 OpenMP 并行方法
  * @param pt 生成用的原 pt
  */
 void PriorityQueue::OpenMPGenerate(PT pt) {
-    // 计算PT的概率，这里主要是给PT的概率进行初始化
-    CalProb(pt);
+    GuessJob job;
+    PrepareJob(pt, job);
+
+    // 预先分配好输出位置，每个线程直接写入自己负责的一段，不需要临界区，输出顺序与串行 Generate 相同
+    size_t base = guesses.size();
+    guesses.resize(base + (job.end - job.begin));
+    string *out = guesses.data() + base;
 
-    // 对于只有一个segment的PT，直接遍历生成其中的所有value即可
-    if (pt.content.size() == 1)
+    #pragma omp parallel num_threads(gen_threads)
     {
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        // 在模型中定位到这个segment
-        if (pt.content[0].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[0])];
-        }
-        if (pt.content[0].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[0])];
-        }
-        if (pt.content[0].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[0])];
-        }
+        // 主要逻辑：按线程号静态划分区间，每个线程连续生成一段猜测
+        long long start, end;
+        ThreadRange(job.begin, job.end, omp_get_thread_num(), omp_get_num_threads(), start, end);
+        FillGuesses(job, start, end, out + (start - job.begin));
+    }
+    total_guesses += job.end - job.begin;
+}
 
-        #pragma omp parallel
-        {
-            // 局部向量存储单个线程生成的猜测
-            std::vector<std::string> thread_guesses;
+/**
+ * OpenMPPersistentGenerate: 常驻并行区域的 OpenMP 方法
+ * OpenMPGenerate 每个 PT 都要开启一次 #pragma omp parallel，PT 较小时线程的创建/唤醒开销占比很高。
+ * 这里在一个并行区域内连续处理多个 PT：队列维护（PlanBlock/PrepareJob/FinishFront）由单个线程完成，
+ * 猜测生成由所有线程按预先划分好的区间写入 guesses，输出顺序与串行 Generate 完全一致。
+ * @param target 至少生成的猜测数，达到后（或队列为空时）退出并行区域
+ */
+void PriorityQueue::OpenMPPersistentGenerate(long long target) {
+    GuessJob job;
+    string *out = NULL;
+    long long generated = 0;
+    bool stop = false;
 
-            // 主要逻辑：循环生成猜测，OpenMP 自动分配线程任务
-            #pragma omp for nowait
-            for (int i = 0; i < pt.max_indices[0]; i++)
-            {
-                std::string guess = a->ordered_values[i];
-                thread_guesses.emplace_back(guess);
-            }
-
-            // 临界区：生成结果写入 pt 的猜测向量组，保证线程访问独立安全
-            #pragma omp critical
-            {
-                guesses.insert(guesses.end(), thread_guesses.begin(), thread_guesses.end());
-                total_guesses += thread_guesses.size();
-            }
-        }
-    }
-    else
+    #pragma omp parallel num_threads(gen_threads)
     {
-        string guess;
-        int seg_idx = 0;
-        // 这个for循环的作用：给当前PT的所有segment赋予实际的值（最后一个segment除外）
-        // segment值根据curr_indices中对应的值加以确定
-        // 这个for循环你看不懂也没太大问题，并行算法不涉及这里的加速
-        for (int idx : pt.curr_indices)
+        while (true)
         {
-            if (pt.content[seg_idx].type == 1)
-            {
-                guess += m.letters[m.FindLetter(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 2)
+            // 单线程：准备下一个 PT 的生成任务，并预先分配输出位置
+            #pragma omp single
             {
-                guess += m.digits[m.FindDigit(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 3)
-            {
-                guess += m.symbols[m.FindSymbol(pt.content[seg_idx])].ordered_values[idx];
+                stop = priority.empty() || generated >= target;
+                if (!stop)
+                {
+                    if (priority.front().gen_offset == 0)
+                    {
+                        PlanBlock(priority.front());
+                    }
+                    RecordSpan(priority.front());
+                    PrepareJob(priority.front(), job);
+                    size_t base = guesses.size();
+                    guesses.resize(base + (job.end - job.begin));
+                    out = guesses.data() + base;
+                }
             }
-            seg_idx += 1;
-            if (seg_idx == pt.content.size() - 1)
+            // single 结束处有隐式 barrier，所有线程看到同一个 stop/job
+            if (stop)
             {
                 break;
             }
-        }
 
-        // 指向最后一个segment的指针，这个指针实际指向模型中的统计数据
-        segment *a;
-        if (pt.content[pt.content.size() - 1].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[pt.content.size() - 1])];
-        }
-
-        #pragma omp parallel
-        {
-            // 局部向量存储单个线程生成的猜测
-            std::vector<std::string> thread_guesses;
-
-            // 主要逻辑：循环生成猜测，OpenMP 自动分配线程任务
-            #pragma omp for nowait
-            for (int i = 0; i < pt.max_indices[pt.content.size() - 1]; i++)
-            {
-                std::string temp = guess + a->ordered_values[i];
-                thread_guesses.emplace_back(temp);
-            }
+            // 所有线程：各自生成自己的一段
+            long long start, end;
+            ThreadRange(job.begin, job.end, omp_get_thread_num(), omp_get_num_threads(), start, end);
+            FillGuesses(job, start, end, out + (start - job.begin));
 
-            // 临界区：生成结果写入 pt 的猜测向量组，保证线程访问独立安全
-            #pragma omp critical
+            // 单线程：队首善后（隐式 barrier 保证所有线程都已写完）
+            #pragma omp barrier
+            #pragma omp single
             {
-                guesses.insert(guesses.end(), thread_guesses.begin(), thread_guesses.end());
-                total_guesses += thread_guesses.size();
+                generated += job.end - job.begin;
+                total_guesses += job.end - job.begin;
+                FinishFront();
             }
         }
     }
@@ -890,305 +869,844 @@ void PriorityQueue::OpenMPGenerate(PT pt) {
 
 // ============= mpi 相关实现 ============= //
 
+/**
+ * RankRange: 将区间 [begin, end) 按进程数均分，求当前进程负责的子区间
+ * 前 remain_pack 个进程各多分一个元素
+ */
+static void RankRange(long long begin, long long end, int rank, int size, long long &start, long long &stop) {
+    long long total_work = end - begin;
+    long long base_chunk = total_work / size;
+    long long remain_pack = total_work % size;
+
+    if (rank < remain_pack) {
+        start = begin + rank * (base_chunk + 1);
+        stop = start + base_chunk + 1;
+    }
+    else {
+        start = begin + remain_pack * (base_chunk + 1) + (rank - remain_pack) * base_chunk;
+        stop = start + base_chunk;
+    }
+}
+
 void PriorityQueue::MPIGenerate(PT pt) {
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    CalProb(pt);
+    GuessJob job;
+    PrepareJob(pt, job);
 
-    if (pt.content.size() == 1) {
-        segment *a;
-        if (pt.content[0].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[0])];
-        }
-        if (pt.content[0].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[0])];
-        }
-        if (pt.content[0].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[0])];
-        }
+    // 动态划分任务
+    long long start, end;
+    RankRange(job.begin, job.end, rank, size, start, end);
 
+    size_t base = guesses.size();
+    guesses.resize(base + (end - start));
+    FillGuesses(job, start, end, guesses.data() + base);
 
-        int total_work = pt.max_indices[0];
+    // 各进程的队列和划分方式都相同，所有进程合计的猜测数就是整个区间的长度，不需要通信
+    total_guesses += job.end - job.begin;
+}
 
-        // 动态划分任务
-        int base_chunk = total_work / size;
-        int remain_pack = total_work % size;
-        int start, end;
+void PriorityQueue::MPIplusOpenMPGenerate(PT pt) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-        if (rank < remain_pack) {
-            start = rank * (base_chunk + 1);
-            end = start + base_chunk + 1;
-        }
-        else {
-            start = remain_pack * (base_chunk + 1) + (rank - remain_pack) * base_chunk;
-            end = start + base_chunk;
-        }
+    GuessJob job;
+    PrepareJob(pt, job);
 
-        for (int i = start; i < end; i++) {
-            guesses.push_back(a->ordered_values[i]);
-        }
+    long long start, end;
+    RankRange(job.begin, job.end, rank, size, start, end);
 
-        int local_count = end - start;
-        int global_count = 0;
+    // OpenMP 并行部分：预先分配输出位置，各线程写入自己的一段，不需要临界区
+    size_t base = guesses.size();
+    guesses.resize(base + (end - start));
+    string *out = guesses.data() + base;
 
-        // 汇总猜测总数
-        MPI_Allreduce(&local_count, &global_count, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-        total_guesses = global_count;
+    #pragma omp parallel num_threads(gen_threads)
+    {
+        long long t_start, t_end;
+        ThreadRange(start, end, omp_get_thread_num(), omp_get_num_threads(), t_start, t_end);
+        FillGuesses(job, t_start, t_end, out + (t_start - start));
     }
-    else {
-        string prefix;
-        int seg_idx = 0;
-        for (int idx : pt.curr_indices)
-        {
-            if (pt.content[seg_idx].type == 1)
-            {
-                prefix += m.letters[m.FindLetter(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 2)
-            {
-                prefix += m.digits[m.FindDigit(pt.content[seg_idx])].ordered_values[idx];
-            }
-            if (pt.content[seg_idx].type == 3)
-            {
-                prefix += m.symbols[m.FindSymbol(pt.content[seg_idx])].ordered_values[idx];
-            }
-            seg_idx += 1;
-            if (seg_idx == pt.content.size() - 1)
-            {
-                break;
-            }
-        }
 
-        segment *a;
-        if (pt.content[pt.content.size() - 1].type == 1)
-        {
-            a = &m.letters[m.FindLetter(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 2)
-        {
-            a = &m.digits[m.FindDigit(pt.content[pt.content.size() - 1])];
-        }
-        if (pt.content[pt.content.size() - 1].type == 3)
-        {
-            a = &m.symbols[m.FindSymbol(pt.content[pt.content.size() - 1])];
-        }
+    // 同 MPIGenerate：所有进程合计的猜测数由确定的划分直接得出
+    total_guesses += job.end - job.begin;
+}
 
-        int total_work = pt.max_indices[pt.content.size() - 1];
 
-        // 动态划分任务
-        int base_chunk = total_work / size;
-        int remain_pack = total_work % size;
-        int start, end;
+void PriorityQueue::MPIPopNext() {
+    // 初始化
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-        if (rank < remain_pack) {
-            start = rank * (base_chunk + 1);
-            end = start + base_chunk + 1;
-        } else {
-            start = remain_pack * (base_chunk + 1) + (rank - remain_pack) * base_chunk;
-            end = start + base_chunk;
+    // 每次批量划分 PT，batch_size 可调整
+    int batch_size = 4; // 一批处理 4 个 PT，可调整
+    int actual_batch = min(batch_size, (int)priority.size());
+
+    // 提取前 actual_batch 个 PT
+    vector<PT> batch_pt(priority.begin(), priority.begin() + actual_batch);
+
+    // 动态划分 PT 任务给各进程
+    long long start, end;
+    RankRange(0, actual_batch, rank, size, start, end);
+
+    // 各进程的队列相同，对同一批 PT 确定的块展开也相同
+    for (PT &pt : batch_pt) {
+        if (pt.gen_offset == 0) {
+            PlanBlock(pt);
         }
+    }
+
+    // 这一批所有进程合计的猜测数：各 PT 剩余的猜测数之和，每个进程都能算出，不需要通信
+    long long batch_total = 0;
+    for (PT &pt : batch_pt) {
+        batch_total += GuessCount(pt) - pt.gen_offset;
+    }
+    long long old_total = total_guesses;
 
-        for (int i = start; i < end; ++i) {
-            guesses.push_back(prefix + a->ordered_values[i]);
+    // 每个进程串行处理自己负责的 PT（PT 的剩余猜测全部展开）
+    for (int i = start; i < end; ++i) {
+        PT pt = batch_pt[i];
+        while (pt.gen_offset < GuessCount(pt)) {
+            RecordSpan(pt);
+            Generate(pt);
+            pt.gen_offset = min(GuessCount(pt), pt.gen_offset + MAX_BATCH_GUESSES);
         }
+    }
 
-        int local_count = end - start;
-        int global_count = 0;
+    // Generate 累加的是本进程的猜测数，改为所有进程的合计
+    total_guesses = old_total + batch_total;
 
-        // 汇总猜测总数
-        MPI_Allreduce(&local_count, &global_count, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-        total_guesses = global_count;
+    // 生成下一批的 PT
+    vector<PT> new_pts;
+    for (PT &pt : batch_pt) {
+        vector<PT> generated_pts = pt.NewPTs();
+        for (PT& gen_pt : generated_pts) {
+            CalChildProb(pt, gen_pt);
+            gen_pt.gen_offset = 0;
+            gen_pt.block_len = 1;
+            new_pts.push_back(gen_pt);
+        }
     }
+
+    // 队列中删除已处理的 PT，只保留一个位置作为 InsertPT 跳过的队首
+    priority.erase(priority.begin(), priority.begin() + actual_batch - 1);
+
+    // 插入新生成的 PT
+    for (PT& pt : new_pts) {
+        InsertPT(pt);
+    }
+    priority.erase(priority.begin());
 }
 
-void PriorityQueue::MPIplusOpenMPGenerate(PT pt) {
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+/**
+ * PartitionRoots: 分布式队列，只保留本进程负责的初始 PT
+ * 初始队列按概率降序排列，第 i 个 PT 分给第 i % size 个进程，使各进程分到的概率质量大致相同
+ * @param rank 本进程编号
+ * @param size 进程数
+ */
+void PriorityQueue::PartitionRoots(int rank, int size) {
+    vector<PT> owned;
+    for (size_t i = rank; i < priority.size(); i += size) {
+        owned.push_back(priority[i]);
+    }
+    priority.swap(owned);
+}
 
-    CalProb(pt);
+/**
+ * FrontProb: 本地队首的概率，队列为空时为 0
+ */
+float PriorityQueue::FrontProb() const {
+    return priority.empty() ? 0 : priority.front().prob;
+}
 
-    if (pt.content.size() == 1) {
-        segment *a;
-        if (pt.content[0].type == 1) {
-            a = &m.letters[m.FindLetter(pt.content[0])];
-        } else if (pt.content[0].type == 2) {
-            a = &m.digits[m.FindDigit(pt.content[0])];
-        } else if (pt.content[0].type == 3) {
-            a = &m.symbols[m.FindSymbol(pt.content[0])];
-        }
+/**
+ * DistributedStep: 分布式队列的一步
+ * 只展开概率不低于 floor 的 PT，队首概率低于 floor 的进程本步不生成，等待其他进程的概率降下来，
+ * 这样各进程之间的生成顺序与单一队列相比只差一个水位线比例（DIST_WATERMARK_RATIO）
+ * @param floor 本步允许展开的最低概率
+ * @param budget 本步最多生成的猜测数（达到后停止，不打断一个 PT 的一次展开）
+ * @return 本步生成的猜测数
+ */
+long long PriorityQueue::DistributedStep(float floor, long long budget) {
+    long long generated = 0;
+    while (!priority.empty() && priority.front().prob >= floor && generated < budget) {
+        size_t before = guesses.size();
+        PopNext();
+        generated += guesses.size() - before;
+    }
+    return generated;
+}
 
-        int total_work = pt.max_indices[0];
+/**
+ * BuildTask: 主从调度中组装一个任务
+ * 任务由若干片组成，每片是某个 PT 的一段猜测区间，编码为
+ * [root, block_len, gen_offset, start, end, n, curr_indices[0..n-1]]
+ * 小 PT 整个作为一片，合并到同一个任务中，直到任务达到 MW_TASK_GUESSES；
+ * 大 PT 按引导式自调度切分：每片取剩余猜测数 / 工作进程数（不小于 MW_MIN_TASK_GUESSES），
+ * 开始时片较大以减少通信，接近末尾时片变小，使各工作进程大致同时完成
+ * @param[out] task 任务编码
+ * @param workers 工作进程数
+ * @return 任务中的猜测数
+ */
+long long PriorityQueue::BuildTask(vector<long long> &task, int workers) {
+    task.clear();
+    long long total = 0;
+    while (!priority.empty() && total < MW_TASK_GUESSES) {
+        PT &front = priority.front();
+        if (mw_cursor < 0) {
+            if (front.gen_offset == 0) {
+                PlanBlock(front);
+            }
+            mw_cursor = front.gen_offset;
+        }
+        long long job_end = min(GuessCount(front), front.gen_offset + MAX_BATCH_GUESSES);
+        long long remaining = job_end - mw_cursor;
+        long long chunk = max((long long)MW_MIN_TASK_GUESSES, min(MW_TASK_GUESSES - total, remaining / workers));
+        chunk = min(chunk, remaining);
+
+        task.push_back(front.root);
+        task.push_back(front.block_len);
+        task.push_back(front.gen_offset);
+        task.push_back(mw_cursor);
+        task.push_back(mw_cursor + chunk);
+        task.push_back(front.curr_indices.size());
+        task.insert(task.end(), front.curr_indices.begin(), front.curr_indices.end());
+
+        mw_cursor += chunk;
+        total += chunk;
+        if (mw_cursor == job_end) {
+            // 本次展开已全部下发，推进队列（可能生成子 PT 并出队）
+            FinishFront();
+            mw_cursor = -1;
+        }
+    }
+    return total;
+}
 
-        int base_chunk = total_work / size;
-        int remain_pack = total_work % size;
-        int start, end;
+/**
+ * MasterSchedule: 主从调度的主进程
+ * 主进程独占优先队列，不生成猜测，只按请求下发任务；任务用 MPI_Isend 发出，不等待工作进程接收
+ * @param limit 下发的猜测数超过该值后不再下发新任务
+ * @return 下发的猜测总数
+ */
+long long PriorityQueue::MasterSchedule(long long limit) {
+    MPI_Comm comm = (comm_thread != NULL) ? comm_thread->comm() : MPI_COMM_WORLD;
+    int size;
+    MPI_Comm_size(comm, &size);
+    int workers = size - 1;
+
+    // 每个工作进程一个发送缓冲区，上一次的发送完成之前不能复用
+    vector<vector<long long>> buffers(size);
+    vector<MPI_Request> requests(size, MPI_REQUEST_NULL);
+
+    long long handed = 0;
+    int stopped = 0;
+    while (stopped < workers) {
+        int dummy;
+        MPI_Status status;
+        MPI_Recv(&dummy, 1, MPI_INT, MPI_ANY_SOURCE, MW_TAG_REQUEST, comm, &status);
+        int worker = status.MPI_SOURCE;
+
+        // 工作进程在收到上一个任务之后才会发出下一个请求，这里的等待会立即返回
+        MPI_Wait(&requests[worker], MPI_STATUS_IGNORE);
+        buffers[worker].clear();
+        if (handed <= limit) {
+            handed += BuildTask(buffers[worker], workers);
+        }
+        if (buffers[worker].empty()) {
+            stopped += 1;
+        }
+        MPI_Isend(buffers[worker].data(), buffers[worker].size(), MPI_LONG_LONG, worker, MW_TAG_TASK,
+                  comm, &requests[worker]);
+    }
+    MPI_Waitall(size, requests.data(), MPI_STATUSES_IGNORE);
+    return handed;
+}
 
-        if (rank < remain_pack) {
-            start = rank * (base_chunk + 1);
-            end = start + base_chunk + 1;
-        } else {
-            start = remain_pack * (base_chunk + 1) + (rank - remain_pack) * base_chunk;
-            end = start + base_chunk;
+/**
+ * WorkerFetch: 主从调度的工作进程，取得一个任务并生成
+ * 工作进程的队列只用于查找各初始 PT 的结构；生成结果留在本进程（追加到 guesses）
+ * @return 是否取得了任务，收到结束消息时返回 false
+ */
+bool PriorityQueue::WorkerFetch() {
+    if (mw_roots.empty()) {
+        mw_roots.resize(priority.size());
+        for (PT &pt : priority) {
+            mw_roots[pt.root] = pt;
         }
+    }
 
-        std::vector<std::string> local_guesses;
+    vector<long long> task;
+    if (comm_thread != NULL && comm_thread->threaded()) {
+        // 通信线程：请求并接收一个任务，存入 mw_next
+        CommTask fetch = [this](MPI_Comm comm) {
+            int dummy = 0;
+            MPI_Send(&dummy, 1, MPI_INT, 0, MW_TAG_REQUEST, comm);
+            MPI_Status status;
+            int count;
+            MPI_Probe(0, MW_TAG_TASK, comm, &status);
+            MPI_Get_count(&status, MPI_LONG_LONG, &count);
+            mw_next.resize(count);
+            MPI_Recv(mw_next.data(), count, MPI_LONG_LONG, 0, MW_TAG_TASK, comm, MPI_STATUS_IGNORE);
+        };
+        if (!mw_requested) {
+            comm_thread->post(fetch);
+        }
+        comm_thread->wait();
+        task.swap(mw_next);
+        if (task.empty()) {
+            mw_requested = false;
+            return false;
+        }
+        // 预取：通信线程在本任务生成期间请求并接收下一个任务
+        comm_thread->post(fetch);
+        mw_requested = true;
+    }
+    else {
+        MPI_Comm comm = (comm_thread != NULL) ? comm_thread->comm() : MPI_COMM_WORLD;
+        int dummy = 0;
+        if (!mw_requested) {
+            MPI_Send(&dummy, 1, MPI_INT, 0, MW_TAG_REQUEST, comm);
+        }
+        MPI_Status status;
+        int count;
+        MPI_Probe(0, MW_TAG_TASK, comm, &status);
+        MPI_Get_count(&status, MPI_LONG_LONG, &count);
+        task.resize(count);
+        MPI_Recv(task.data(), count, MPI_LONG_LONG, 0, MW_TAG_TASK, comm, MPI_STATUS_IGNORE);
+        if (count == 0) {
+            mw_requested = false;
+            return false;
+        }
+
+        // 预取：先请求下一个任务，再生成本任务
+        MPI_Send(&dummy, 1, MPI_INT, 0, MW_TAG_REQUEST, comm);
+        mw_requested = true;
+    }
 
-        // OpenMP 并行部分
-        #pragma omp parallel
+    size_t pos = 0;
+    while (pos < task.size()) {
+        PT pt = mw_roots[task[pos]];
+        pt.block_len = task[pos + 1];
+        long long start = task[pos + 3];
+        long long end = task[pos + 4];
+        int n = task[pos + 5];
+        pt.curr_indices.assign(task.begin() + pos + 6, task.begin() + pos + 6 + n);
+        pos += 6 + n;
+
+        // 来源记录中的 gen_offset 记为本片的起点
+        pt.gen_offset = start;
+        RecordSpan(pt);
+
+        GuessJob job;
+        PrepareRange(pt, start, end, job);
+        size_t base = guesses.size();
+        guesses.resize(base + (end - start));
+        string *out = guesses.data() + base;
+        #pragma omp parallel num_threads(gen_threads) if (end - start >= MW_MIN_TASK_GUESSES)
         {
-            std::vector<std::string> thread_guesses;
+            long long t_start, t_end;
+            ThreadRange(start, end, omp_get_thread_num(), omp_get_num_threads(), t_start, t_end);
+            FillGuesses(job, t_start, t_end, out + (t_start - start));
+        }
+        total_guesses += end - start;
+    }
+    return true;
+}
 
-            #pragma omp for nowait schedule(static)
-            for (int i = start; i < end; i++) {
-                thread_guesses.push_back(a->ordered_values[i]);
-            }
+// ======================================= //
 
-            #pragma omp critical
-            {
-                guesses.insert(guesses.end(), thread_guesses.begin(), thread_guesses.end());
-            }
+// ========== 生成方法注册与自适应选择 ========== //
+
+const genBackend_t gen_backends[GEN_BACKEND_NUM] = {
+    {"serial", &PriorityQueue::Generate},
+    {"pthread", &PriorityQueue::PthreadGenerate},
+    {"pthread_pool", &PriorityQueue::PthreadPoolGenerate},
+    {"openmp", &PriorityQueue::OpenMPGenerate},
+    {"mpi", &PriorityQueue::MPIGenerate},
+    {"mpi_openmp", &PriorityQueue::MPIplusOpenMPGenerate},
+    {"adaptive", &PriorityQueue::AdaptiveGenerate},
+    {"openmp_persistent", &PriorityQueue::OpenMPGenerate},   // 逐个 PT 展开时同 openmp，批量展开见 PopBatch
+};
+
+// 自适应策略的候选方法。MPI 方法需要所有进程步调一致，而各进程的计时结果不同，不能参与自适应选择
+static const int adaptive_candidates[] = {GEN_SERIAL, GEN_OPENMP, GEN_PTHREAD_POOL};
+
+/**
+ * SetBackend: 按名称选择生成方法
+ * @param name 方法名称，见 gen_backends
+ * @return 是否找到该方法
+ */
+bool PriorityQueue::SetBackend(const string &name) {
+    for (int i = 0; i < GEN_BACKEND_NUM; i++) {
+        if (name == gen_backends[i].name) {
+            backend = i;
+            return true;
         }
+    }
+    return false;
+}
 
-        int local_count = end - start;
-        int global_count = 0;
-        MPI_Allreduce(&local_count, &global_count, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-        total_guesses = global_count;
+/**
+ * RateBucket: 单次展开的猜测数所在的桶（按 log2 分桶）
+ */
+static int RateBucket(long long count) {
+    int bucket = 0;
+    while (count > 1 && bucket < ADAPTIVE_BUCKETS - 1) {
+        count >>= 1;
+        bucket++;
     }
-    else {
-        string prefix;
-        int seg_idx = 0;
-        for (int idx : pt.curr_indices) {
-            if (pt.content[seg_idx].type == 1) {
-                prefix += m.letters[m.FindLetter(pt.content[seg_idx])].ordered_values[idx];
-            } else if (pt.content[seg_idx].type == 2) {
-                prefix += m.digits[m.FindDigit(pt.content[seg_idx])].ordered_values[idx];
-            } else if (pt.content[seg_idx].type == 3) {
-                prefix += m.symbols[m.FindSymbol(pt.content[seg_idx])].ordered_values[idx];
+    return bucket;
+}
+
+/**
+ * AdaptiveChoice: 在某个桶中选择吞吐量最高的候选方法
+ * 该桶还没有测量数据时，使用最近的、有测量数据的桶；完全没有数据时使用串行方法
+ */
+static int AdaptiveChoice(const double (*rate)[GEN_BACKEND_NUM], int bucket) {
+    for (int dist = 0; dist < ADAPTIVE_BUCKETS; dist++) {
+        for (int b : {bucket - dist, bucket + dist}) {
+            if (b < 0 || b >= ADAPTIVE_BUCKETS) {
+                continue;
+            }
+            int best = -1;
+            for (int candidate : adaptive_candidates) {
+                if (candidate == GEN_PTHREAD_POOL && !thread_pool) {
+                    continue;
+                }
+                if (rate[b][candidate] > 0 && (best < 0 || rate[b][candidate] > rate[b][best])) {
+                    best = candidate;
+                }
+            }
+            if (best >= 0) {
+                return best;
             }
-            seg_idx += 1;
-            if (seg_idx == pt.content.size() - 1) break;
         }
+    }
+    return GEN_SERIAL;
+}
 
-        segment *a;
-        if (pt.content[pt.content.size() - 1].type == 1) {
-            a = &m.letters[m.FindLetter(pt.content[pt.content.size() - 1])];
-        } else if (pt.content[pt.content.size() - 1].type == 2) {
-            a = &m.digits[m.FindDigit(pt.content[pt.content.size() - 1])];
-        } else if (pt.content[pt.content.size() - 1].type == 3) {
-            a = &m.symbols[m.FindSymbol(pt.content[pt.content.size() - 1])];
-        }
+/**
+ * AdaptiveGenerate: pt 生成猜测的自适应方法
+ * 按本次展开的猜测数分桶，选择该规模下实测吞吐量最高的方法，
+ * 并用这次的计时结果更新该方法的吞吐量（指数滑动平均），使选择随运行情况调整
+ * @param pt 生成用的原 pt
+ */
+void PriorityQueue::AdaptiveGenerate(PT pt) {
+    long long count = min(GuessCount(pt), pt.gen_offset + MAX_BATCH_GUESSES) - pt.gen_offset;
+    int bucket = RateBucket(count);
+    int choice = AdaptiveChoice(adaptive_rate, bucket);
+
+    double start = omp_get_wtime();
+    (this->*gen_backends[choice].func)(pt);
+    double elapsed = omp_get_wtime() - start;
+
+    if (elapsed > 0) {
+        double rate = count / elapsed;
+        double &old_rate = adaptive_rate[bucket][choice];
+        old_rate = (old_rate > 0) ? 0.8 * old_rate + 0.2 * rate : rate;
+    }
+}
 
-        int total_work = pt.max_indices[pt.content.size() - 1];
+/**
+ * TimeBackend: 用某种方法展开一个 PT 若干次，返回最短耗时（秒）
+ * 生成的猜测随即丢弃，guesses 与 total_guesses 恢复原状
+ */
+static double TimeBackend(PriorityQueue &q, int method, const PT &pt, int repeat) {
+    size_t old_size = q.guesses.size();
+    long long old_total = q.total_guesses;
+    double best = -1;
+    for (int r = 0; r < repeat; r++) {
+        double start = omp_get_wtime();
+        (q.*gen_backends[method].func)(pt);
+        double elapsed = omp_get_wtime() - start;
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+        q.guesses.resize(old_size);
+        q.total_guesses = old_total;
+    }
+    return best;
+}
 
-        int base_chunk = total_work / size;
-        int remain_pack = total_work % size;
-        int start, end;
+/**
+ * ThreadCandidates: 标定时尝试的线程数：从 1 开始倍增，最后总是包含处理器数本身
+ * （处理器数不是 2 的幂时，例如 6 核或 12 核，只倍增会漏掉用满所有核的情况）
+ */
+static vector<int> ThreadCandidates() {
+    int procs = omp_get_num_procs();
+    vector<int> candidates;
+    for (int threads = 1; threads < procs; threads *= 2) {
+        candidates.push_back(threads);
+    }
+    candidates.push_back(procs);
+    return candidates;
+}
 
-        if (rank < remain_pack) {
-            start = rank * (base_chunk + 1);
-            end = start + base_chunk + 1;
-        } else {
-            start = remain_pack * (base_chunk + 1) + (rank - remain_pack) * base_chunk;
-            end = start + base_chunk;
+/**
+ * CalibrateBackends: 启动时在本机上标定各生成方法
+ * 1. 用队列中规模最大的 PT，依次尝试不同的 OpenMP 线程数、线程池线程数和线程池任务粒度，取最快的参数
+ *    （线程池线程数在创建时固定，每试一个线程数重建一次线程池，最后按最快的线程数重建）
+ * 2. 从队列中按规模（log2 分桶）各取一个 PT，分别用各候选方法计时，得到初始的吞吐量表
+ * 3. 线程池方法的串行阈值取线程池开始快于串行方法的最小规模
+ * 需要在 init 之后调用；如需标定线程池方法，需要先 initThreadPool
+ */
+void PriorityQueue::CalibrateBackends() {
+    // 按规模为每个桶挑选一个 PT（只取其第一次展开）
+    vector<int> sample(ADAPTIVE_BUCKETS, -1);
+    int largest = -1;
+    long long largest_count = 0;
+    for (size_t i = 0; i < priority.size(); i++) {
+        PT pt = priority[i];
+        PlanBlock(pt);
+        long long count = min(GuessCount(pt), (long long)MAX_BATCH_GUESSES);
+        int bucket = RateBucket(count);
+        if (sample[bucket] < 0) {
+            sample[bucket] = i;
+        }
+        if (count > largest_count) {
+            largest_count = count;
+            largest = i;
         }
+    }
+    if (largest < 0) {
+        return;
+    }
+    PT big = priority[largest];
+    PlanBlock(big);
+
+    // OpenMP 线程数：从 1 开始倍增，以及处理器数
+    int best_threads = gen_threads;
+    double best_time = -1;
+    for (int threads : ThreadCandidates()) {
+        gen_threads = threads;
+        double t = TimeBackend(*this, GEN_OPENMP, big, 3);
+        if (best_time < 0 || t < best_time) {
+            best_time = t;
+            best_threads = threads;
+        }
+    }
+    gen_threads = best_threads;
 
-        std::vector<std::string> local_guesses;
-
-        // OpenMP 并行部分
-        #pragma omp parallel
-        {
-            std::vector<std::string> thread_guesses;
-
-            #pragma omp for nowait schedule(static)
-            for (int i = start; i < end; i++) {
-                thread_guesses.push_back(prefix + a->ordered_values[i]);
+    if (thread_pool) {
+        long long saved_threshold = pool_serial_threshold;
+        pool_serial_threshold = 0;
+
+        // 线程池线程数：与 OpenMP 线程数的候选相同
+        int best_pool_threads = pool_threads;
+        best_time = -1;
+        for (int threads : ThreadCandidates()) {
+            deleteThreadPool();
+            initThreadPool(threads);
+            double t = TimeBackend(*this, GEN_PTHREAD_POOL, big, 3);
+            if (best_time < 0 || t < best_time) {
+                best_time = t;
+                best_pool_threads = threads;
             }
-
-            #pragma omp critical
-            {
-                guesses.insert(guesses.end(), thread_guesses.begin(), thread_guesses.end());
+        }
+        deleteThreadPool();
+        initThreadPool(best_pool_threads);
+        pool_threads = best_pool_threads;
+
+        // 线程池任务粒度
+        long long best_chunk = pool_chunk_size;
+        best_time = -1;
+        for (long long chunk : {POOL_CHUNK_SIZE / 4, POOL_CHUNK_SIZE, POOL_CHUNK_SIZE * 4}) {
+            pool_chunk_size = chunk;
+            double t = TimeBackend(*this, GEN_PTHREAD_POOL, big, 3);
+            if (best_time < 0 || t < best_time) {
+                best_time = t;
+                best_chunk = chunk;
             }
         }
+        pool_chunk_size = best_chunk;
+        pool_serial_threshold = saved_threshold;
+    }
 
-        int local_count = end - start;
-        int global_count = 0;
-        MPI_Allreduce(&local_count, &global_count, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-        total_guesses = global_count;
+    // 各规模下各方法的吞吐量；线程池方法标定时关闭其内部的串行阈值
+    long long saved_threshold = pool_serial_threshold;
+    pool_serial_threshold = 0;
+    long long pool_min = -1;
+    for (int b = 0; b < ADAPTIVE_BUCKETS; b++) {
+        if (sample[b] < 0) {
+            continue;
+        }
+        PT pt = priority[sample[b]];
+        PlanBlock(pt);
+        long long count = min(GuessCount(pt), (long long)MAX_BATCH_GUESSES);
+        for (int candidate : adaptive_candidates) {
+            if (candidate == GEN_PTHREAD_POOL && !thread_pool) {
+                continue;
+            }
+            double t = TimeBackend(*this, candidate, pt, 3);
+            adaptive_rate[b][candidate] = (t > 0) ? count / t : 1e18;
+        }
+        if (thread_pool && pool_min < 0 && adaptive_rate[b][GEN_PTHREAD_POOL] > adaptive_rate[b][GEN_SERIAL]) {
+            pool_min = 1LL << b;
+        }
     }
+    pool_serial_threshold = (pool_min >= 0) ? pool_min : saved_threshold;
 }
 
+// ======================================= //
 
-void PriorityQueue::MPIPopNext() {
-    // 初始化
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+// =========== 概率阈值枚举 =========== //
 
-    // 每次批量划分 PT，batch_size 可调整
-    int batch_size = 4; // 一批处理 4 个 PT，可调整
-    int actual_batch = min(batch_size, (int)priority.size());
+/**
+ * ThresholdSearch: 深度优先搜索一个初始 PT 下概率不低于 floor 的全部 PT
+ * 各 segment 的 value 类按概率降序排列，因此固定前面的 segment 之后，概率随本 segment 的类下标单调不增：
+ * 某一类乘上其余 segment 的最大概率（bound）仍低于 floor 时，之后的类都可以剪掉
+ * 概率按与 CalProb 相同的顺序累乘，找到的 PT 与队列计算的概率一致
+ * @param pt 正在搜索的 PT，前 pos 个 segment 的类下标已经确定
+ * @param pos 本层确定的 segment
+ * @param prob 前 pos 个 segment（及 PT 本身）的概率之积
+ * @param floor 概率阈值
+ * @param bound bound[k] 为第 k 个及之后的 segment 的最大概率之积
+ * @param[out] found 找到的 PT
+ */
+void PriorityQueue::ThresholdSearch(PT &pt, int pos, float prob, float floor, const vector<float> &bound, vector<PT> &found) {
+    int last = pt.content.size() - 1;
+    if (pos == last) {
+        // 最后一个 segment 的全部 value 一起生成，PT 的概率取其中最高的（第 0 类），与队列相同
+        prob *= m.GetSegment(pt, last).class_probs[0];
+        if (prob >= floor) {
+            pt.prob = prob;
+            found.push_back(pt);
+        }
+        return;
+    }
+    segment &seg = m.GetSegment(pt, pos);
+    for (int c = 0; c < pt.max_indices[pos]; c++) {
+        float p = prob * seg.class_probs[c];
+        // 剪枝的上界按另一种乘法顺序计算，留一点余量，避免舍入误差剪掉恰好等于阈值的 PT
+        if (p * bound[pos + 1] < floor * 0.9999f) {
+            break;
+        }
+        pt.curr_indices[pos] = c;
+        ThresholdSearch(pt, pos + 1, p, floor, bound, found);
+    }
+    pt.curr_indices[pos] = 0;
+}
 
-    // 提取前 actual_batch 个 PT
-    vector<PT> batch_pt(priority.begin(), priority.begin() + actual_batch);
+/**
+ * ThresholdPlan: 概率阈值枚举的规划
+ * 每个初始 PT 一棵搜索树，由 OpenMP 线程动态领取；结果按初始 PT 的顺序拼接（与线程数无关），
+ * 第 i 个 PT 分给第 i % size 个进程
+ * @param floor 概率阈值
+ * @param rank 本进程编号
+ * @param size 进程数
+ */
+void PriorityQueue::ThresholdPlan(float floor, int rank, int size) {
+    vector<vector<PT>> found(priority.size());
+    #pragma omp parallel for num_threads(gen_threads) schedule(dynamic)
+    for (size_t i = 0; i < priority.size(); i++) {
+        PT pt = priority[i];
+        int n = pt.content.size();
+        vector<float> bound(n + 1, 1.0f);
+        for (int k = n - 1; k >= 0; k--) {
+            bound[k] = bound[k + 1] * m.GetSegment(pt, k).class_probs[0];
+        }
+        ThresholdSearch(pt, 0, pt.preterm_prob, floor, bound, found[i]);
+    }
 
-    // 动态划分 PT 任务给各进程
-    int base_chunk = actual_batch / size;
-    int remain_pack = actual_batch % size;
+    th_units.clear();
+    size_t index = 0;
+    for (vector<PT> &units : found) {
+        for (PT &pt : units) {
+            if (index++ % size == (size_t)rank) {
+                th_units.push_back(pt);
+            }
+        }
+    }
+    th_cursor = 0;
+    th_offset = 0;
+}
 
-    int start, end;
+/**
+ * ThresholdGenerate: 概率阈值枚举的一步
+ * 先按顺序划出本步的切片（每片至多 THRESHOLD_SLICE_GUESSES 个猜测）并确定各片在 guesses 中的位置，
+ * 然后各线程动态领取切片，各自准备前缀并直接写入自己的位置
+ * @param budget 本步最多生成的猜测数
+ * @return 本步生成的猜测数
+ */
+long long PriorityQueue::ThresholdGenerate(long long budget) {
+    struct Slice {
+        size_t unit;
+        long long begin, end;   // PT 内的猜测区间
+        long long out;          // 在本步输出中的位置
+    };
+    vector<Slice> slices;
+    long long total = 0;
+    while (total < budget && th_cursor < th_units.size()) {
+        long long count = GuessCount(th_units[th_cursor]);
+        long long end = min(count, th_offset + min((long long)THRESHOLD_SLICE_GUESSES, budget - total));
+        slices.push_back({th_cursor, th_offset, end, total});
+        total += end - th_offset;
+        th_offset = end;
+        if (th_offset == count) {
+            th_cursor++;
+            th_offset = 0;
+        }
+    }
 
-    if (rank < remain_pack) {
-        start = rank * (base_chunk + 1);
-        end = start + base_chunk + 1;
-    } else {
-        start = remain_pack * (base_chunk + 1) + (rank - remain_pack) * base_chunk;
-        end = start + base_chunk;
+    size_t base = guesses.size();
+    for (const Slice &s : slices) {
+        const PT &pt = th_units[s.unit];
+        GuessSpan span;
+        span.first = base + s.out;
+        span.pattern = pt.Pattern();
+        span.curr_indices = pt.curr_indices;
+        span.gen_offset = s.begin;
+        spans.push_back(span);
+    }
+    guesses.resize(base + total);
+    string *out = guesses.data() + base;
+    #pragma omp parallel for num_threads(gen_threads) schedule(dynamic)
+    for (size_t i = 0; i < slices.size(); i++) {
+        const Slice &s = slices[i];
+        GuessJob job;
+        PrepareRange(th_units[s.unit], s.begin, s.end, job);
+        FillGuesses(job, s.begin, s.end, out + s.out);
     }
+    total_guesses += total;
+    return total;
+}
 
-    // 每个进程串行处理自己负责的 PT
-    for (int i = start; i < end; ++i) {
-        Generate(batch_pt[i]);
+/**
+ * ThresholdDone: 本进程的 PT 是否已经全部生成
+ */
+bool PriorityQueue::ThresholdDone() const {
+    return th_cursor >= th_units.size();
+}
+
+/**
+ * ThresholdUnits: 本进程负责的 PT 数
+ */
+size_t PriorityQueue::ThresholdUnits() const {
+    return th_units.size();
+}
+
+/**
+ * ThresholdGuesses: 本进程负责的猜测总数
+ */
+long long PriorityQueue::ThresholdGuesses() {
+    long long total = 0;
+    for (const PT &pt : th_units) {
+        total += GuessCount(pt);
     }
+    return total;
+}
 
-    // 汇总每个进程的猜测总数
-    int local_count = total_guesses;
-    int global_count = 0;
-    MPI_Allreduce(&local_count, &global_count, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-    total_guesses = global_count;
+// ======================================= //
 
-    // 队列中删除已处理的 PT
-    priority.erase(priority.begin(), priority.begin() + actual_batch);
+// ============== 检查点 ============== //
+
+// 队列中一个 PT 的紧凑编码：结构由初始 PT（root）确定，只需记录各下标、展开进度和概率，
+// 之后是 n 个 int32 的 curr_indices。概率按原始位模式保存，恢复后队列顺序与保存时完全相同
+typedef struct {
+    int32_t root;
+    int32_t pivot;
+    int32_t block_len;
+    int32_t n;
+    int64_t gen_offset;
+    float prob;
+    float preterm_prob;
+    double log_prob;
+} ptState_t;
 
-    // 生成下一批的 PT 并插入队列
-    vector<PT> new_pts;
-    for (PT &pt : batch_pt) {
-        vector<PT> generated_pts = pt.NewPTs();
-        for (PT& gen_pt : generated_pts) {
-            CalProb(pt);
-            generated_pts.push_back(gen_pt);
+/**
+ * SaveState: 将队列的全部内容编码为紧凑的字节序列
+ * @param[out] state 编码结果：int64 PT 数，然后依次为每个 PT 的 ptState_t 和 curr_indices
+ */
+void PriorityQueue::SaveState(vector<char> &state) const {
+    state.clear();
+    int64_t count = priority.size();
+    state.insert(state.end(), (const char *)&count, (const char *)&count + sizeof(count));
+    for (const PT &pt : priority) {
+        ptState_t s = {pt.root, pt.pivot, pt.block_len, (int32_t)pt.curr_indices.size(),
+                       pt.gen_offset, pt.prob, pt.preterm_prob, pt.log_prob};
+        state.insert(state.end(), (const char *)&s, (const char *)&s + sizeof(s));
+        state.insert(state.end(), (const char *)pt.curr_indices.data(),
+                     (const char *)(pt.curr_indices.data() + pt.curr_indices.size()));
+    }
+}
+
+/**
+ * LoadState: 用 SaveState 的编码替换队列内容
+ * 需要在 init 之后、PartitionRoots 之前调用：此时队列中是全部初始 PT，各 PT 的结构
+ * （content / seg_ids / max_indices）从对应的初始 PT 复制
+ * @param state 编码
+ * @param size 编码的字节数
+ * @return 编码是否与当前模型相符（不相符时队列不变）
+ */
+bool PriorityQueue::LoadState(const char *state, size_t size) {
+    vector<const PT *> roots(priority.size(), NULL);
+    for (const PT &pt : priority) {
+        if (pt.root < 0 || pt.root >= (int)roots.size()) {
+            return false;
         }
+        roots[pt.root] = &pt;
     }
-    
-    // 插入新生成的 PT
-    for (PT& pt : new_pts) {
-        bool inserted = false;
-        for (auto iter = priority.begin(); iter != priority.end(); iter++) {
-            if (pt.prob > iter->prob) {
-                priority.emplace(iter, pt);
-                inserted = true;
-                break;
+
+    const char *cursor = state, *end = state + size;
+    int64_t count;
+    if ((size_t)(end - cursor) < sizeof(count)) {
+        return false;
+    }
+    memcpy(&count, cursor, sizeof(count));
+    cursor += sizeof(count);
+    // 每个 PT 至少占一个 ptState_t：PT 数超出剩余字节能容纳的数目时编码已损坏，不按它预留内存
+    if (count < 0 || (uint64_t)count > (size_t)(end - cursor) / sizeof(ptState_t)) {
+        return false;
+    }
+
+    vector<PT> loaded;
+    loaded.reserve(count);
+    for (int64_t i = 0; i < count; i++) {
+        ptState_t s;
+        if ((size_t)(end - cursor) < sizeof(s)) {
+            return false;
+        }
+        memcpy(&s, cursor, sizeof(s));
+        cursor += sizeof(s);
+        if (s.root < 0 || s.root >= (int32_t)roots.size() || roots[s.root] == NULL
+            || s.n != (int32_t)roots[s.root]->curr_indices.size() || (size_t)(end - cursor) < s.n * sizeof(int32_t)) {
+            return false;
+        }
+        PT pt = *roots[s.root];
+        memcpy(pt.curr_indices.data(), cursor, s.n * sizeof(int32_t));
+        cursor += s.n * sizeof(int32_t);
+        // 下标、pivot 和块长度越界的 PT 在展开时会越界访问模型，同样视为损坏
+        for (int32_t k = 0; k < s.n; k++) {
+            if (pt.curr_indices[k] < 0 || pt.curr_indices[k] >= pt.max_indices[k]) {
+                return false;
             }
         }
-        if (!inserted) {
-            priority.emplace_back(pt);
+        if (s.pivot < 0 || s.pivot > s.n || s.block_len < 1 || s.gen_offset < 0) {
+            return false;
+        }
+        // 块展开覆盖倒数第二个 segment 从当前类开始的 block_len 个类，不能超出该 segment 的类数
+        if (s.n >= 2 ? (long long)pt.curr_indices[s.n - 2] + s.block_len > pt.max_indices[s.n - 2] : s.block_len != 1) {
+            return false;
         }
+        pt.pivot = s.pivot;
+        pt.block_len = s.block_len;
+        pt.gen_offset = s.gen_offset;
+        pt.prob = s.prob;
+        pt.preterm_prob = s.preterm_prob;
+        pt.log_prob = s.log_prob;
+        loaded.push_back(pt);
     }
+    if (cursor != end) {
+        return false;
+    }
+    priority.swap(loaded);
+    mw_cursor = -1;
+    return true;
 }
 
-// ======================================= //
\ No newline at end of file
+// ======================================= //
@@ -0,0 +1,360 @@
+#include "hashes.h"
+#include "arena.h"
+
+using namespace std;
+
+/**
+ * SwapBytes: 大小端转换
+ */
+static inline bit32 SwapBytes(bit32 value)
+{
+	return ((value & 0xff) << 24) | ((value & 0xff00) << 8) |
+		   ((value & 0xff0000) >> 8) | ((value & 0xff000000) >> 24);
+}
+
+/**
+ * WidenUTF16: 将单字节字符串扩展为 UTF-16LE（每个字节后补一个 0 字节）
+ * 使用 NEON 的 vzip1q_u8 / vzip2q_u8 指令，一次将 16 个字节与 0 交错，得到 32 个字节
+ * @param src 原始字节（长度需补齐到 16 的倍数，补齐部分为 0）
+ * @param length 原始长度
+ * @param[out] dst 扩展结果，长度为 2 * length（按 32 字节整块写入，需预留空间）
+ */
+static void WidenUTF16(const Byte *src, int length, Byte *dst)
+{
+	uint8x16_t zero = vdupq_n_u8(0);
+	for (int i = 0; i < length; i += 16) {
+		uint8x16_t bytes = vld1q_u8(src + i);
+		vst1q_u8(dst + 2 * i, vzip1q_u8(bytes, zero));
+		vst1q_u8(dst + 2 * i + 16, vzip2q_u8(bytes, zero));
+	}
+}
+
+/**
+ * PadLanes: 对 4 个消息分别做 MD 结构的填充（0x80 + 0 + 64 位长度），各消息按自己的块数填充
+ * @param inputs 输入
+ * @param widen 是否先扩展为 UTF-16LE（NTLM）
+ * @param big_endian 长度字段是否为大端（SHA 系列为大端，MD4 为小端）
+ * @param[out] blocks 各消息的块数
+ * @param[out] stride 各消息在返回的内存块中的步长（最大块数 * 64）
+ * @return 填充后的内存块，分配在当前线程的暂存区中，调用者用完后 rewind 到调用前的 mark
+ */
+static Byte *PadLanes(string *inputs, bool widen, bool big_endian, int *blocks, int &stride)
+{
+	const int PARA_NUM = 4;
+	int lengths[PARA_NUM];
+	int maxBlocks = 0;
+	for (int i = 0; i < PARA_NUM; i++) {
+		lengths[i] = inputs[i].length() * (widen ? 2 : 1);
+		blocks[i] = (lengths[i] + 8) / 64 + 1;
+		maxBlocks = max(maxBlocks, blocks[i]);
+	}
+
+	// 扩展时按 32 字节整块写入，多留出 32 字节
+	stride = maxBlocks * 64 + (widen ? 32 : 0);
+	Byte *paddedData = (Byte *)ThreadArena().alloc(stride * PARA_NUM, 16);
+	memset(paddedData, 0, stride * PARA_NUM);
+
+	for (int i = 0; i < PARA_NUM; i++) {
+		Byte *message = paddedData + i * stride;
+		if (widen) {
+			// 原始字节先放到消息末尾的空闲位置（补齐到 16 的倍数），再扩展到消息开头
+			int rounded = (inputs[i].length() + 15) / 16 * 16;
+			size_t scratchMark = ThreadArena().mark();
+			Byte *scratch = (Byte *)ThreadArena().alloc(rounded + 16, 16);
+			memset(scratch, 0, rounded + 16);
+			memcpy(scratch, inputs[i].data(), inputs[i].length());
+			WidenUTF16(scratch, inputs[i].length(), message);
+			ThreadArena().rewind(scratchMark);
+			// 扩展按整块写入，超出 2 * length 的部分都是 0，不影响填充
+		}
+		else {
+			memcpy(message, inputs[i].data(), lengths[i]);
+		}
+		message[lengths[i]] = 0x80;
+
+		uint64_t bitLength = (uint64_t)lengths[i] * 8;
+		Byte *tail = message + blocks[i] * 64 - 8;
+		for (int i1 = 0; i1 < 8; ++i1) {
+			int shift = big_endian ? (56 - 8 * i1) : (8 * i1);
+			tail[i1] = (bitLength >> shift) & 0xff;
+		}
+	}
+	return paddedData;
+}
+
+/**
+ * LoadWords: 读入 4 个消息第 block 块的 16 个消息字
+ * @param big_endian 是否按大端解释（SHA 系列），使用 vrev32q_u8 在向量内完成字节翻转
+ */
+static inline void LoadWords(const Byte *paddedData, int stride, int block, bool big_endian, uint32x4_t *M)
+{
+	for (int i1 = 0; i1 < 16; ++i1) {
+		uint32_t temp_vec[4];
+		for (int i2 = 0; i2 < 4; ++i2) {
+			memcpy(&temp_vec[i2], paddedData + i2 * stride + block * 64 + 4 * i1, sizeof(uint32_t));
+		}
+		M[i1] = vld1q_u32(temp_vec);
+		if (big_endian) {
+			M[i1] = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(M[i1])));
+		}
+	}
+}
+
+/**
+ * StoreLanes: 将 n_words 个状态向量转置为按口令排列的结果
+ * @param swap 是否做大小端转换（MD4 的结果按小端字节序输出）
+ */
+static inline void StoreLanes(const uint32x4_t *H, int n_words, bool swap, bit32 *state)
+{
+	bit32 lanes[8][4];
+	for (int w = 0; w < n_words; w++) {
+		vst1q_u32(lanes[w], H[w]);
+	}
+	for (int i = 0; i < 4; i++) {
+		for (int w = 0; w < n_words; w++) {
+			state[i * n_words + w] = swap ? SwapBytes(lanes[w][i]) : lanes[w][i];
+		}
+	}
+}
+
+/**
+ * MD4Lanes: MD4 的四路并行实现，SIMDMD4Hash_4 与 SIMDNTLMHash_4 共用
+ * @param widen 是否先将口令扩展为 UTF-16LE
+ */
+static void MD4Lanes(string *inputs, bool widen, bit32 *state)
+{
+	int blocks[4];
+	int stride;
+	size_t arenaMark = ThreadArena().mark();
+	Byte *paddedData = PadLanes(inputs, widen, false, blocks, stride);
+	int maxBlocks = max(max(blocks[0], blocks[1]), max(blocks[2], blocks[3]));
+	uint32x4_t n_blocks = {(uint32_t)blocks[0], (uint32_t)blocks[1], (uint32_t)blocks[2], (uint32_t)blocks[3]};
+
+	uint32x4_t H[4] = {vdupq_n_u32(0x67452301), vdupq_n_u32(0xefcdab89), vdupq_n_u32(0x98badcfe), vdupq_n_u32(0x10325476)};
+
+	for (int i = 0; i < maxBlocks; i += 1) {
+		uint32x4_t M[16];
+		LoadWords(paddedData, stride, i, false, M);
+
+		uint32x4_t a = H[0], b = H[1], c = H[2], d = H[3];
+
+		/* Round 1 */
+		MD4_FF_SIMD(a, b, c, d, M[0], 3);
+		MD4_FF_SIMD(d, a, b, c, M[1], 7);
+		MD4_FF_SIMD(c, d, a, b, M[2], 11);
+		MD4_FF_SIMD(b, c, d, a, M[3], 19);
+		MD4_FF_SIMD(a, b, c, d, M[4], 3);
+		MD4_FF_SIMD(d, a, b, c, M[5], 7);
+		MD4_FF_SIMD(c, d, a, b, M[6], 11);
+		MD4_FF_SIMD(b, c, d, a, M[7], 19);
+		MD4_FF_SIMD(a, b, c, d, M[8], 3);
+		MD4_FF_SIMD(d, a, b, c, M[9], 7);
+		MD4_FF_SIMD(c, d, a, b, M[10], 11);
+		MD4_FF_SIMD(b, c, d, a, M[11], 19);
+		MD4_FF_SIMD(a, b, c, d, M[12], 3);
+		MD4_FF_SIMD(d, a, b, c, M[13], 7);
+		MD4_FF_SIMD(c, d, a, b, M[14], 11);
+		MD4_FF_SIMD(b, c, d, a, M[15], 19);
+
+		/* Round 2 */
+		MD4_GG_SIMD(a, b, c, d, M[0], 3);
+		MD4_GG_SIMD(d, a, b, c, M[4], 5);
+		MD4_GG_SIMD(c, d, a, b, M[8], 9);
+		MD4_GG_SIMD(b, c, d, a, M[12], 13);
+		MD4_GG_SIMD(a, b, c, d, M[1], 3);
+		MD4_GG_SIMD(d, a, b, c, M[5], 5);
+		MD4_GG_SIMD(c, d, a, b, M[9], 9);
+		MD4_GG_SIMD(b, c, d, a, M[13], 13);
+		MD4_GG_SIMD(a, b, c, d, M[2], 3);
+		MD4_GG_SIMD(d, a, b, c, M[6], 5);
+		MD4_GG_SIMD(c, d, a, b, M[10], 9);
+		MD4_GG_SIMD(b, c, d, a, M[14], 13);
+		MD4_GG_SIMD(a, b, c, d, M[3], 3);
+		MD4_GG_SIMD(d, a, b, c, M[7], 5);
+		MD4_GG_SIMD(c, d, a, b, M[11], 9);
+		MD4_GG_SIMD(b, c, d, a, M[15], 13);
+
+		/* Round 3 */
+		MD4_HH_SIMD(a, b, c, d, M[0], 3);
+		MD4_HH_SIMD(d, a, b, c, M[8], 9);
+		MD4_HH_SIMD(c, d, a, b, M[4], 11);
+		MD4_HH_SIMD(b, c, d, a, M[12], 15);
+		MD4_HH_SIMD(a, b, c, d, M[2], 3);
+		MD4_HH_SIMD(d, a, b, c, M[10], 9);
+		MD4_HH_SIMD(c, d, a, b, M[6], 11);
+		MD4_HH_SIMD(b, c, d, a, M[14], 15);
+		MD4_HH_SIMD(a, b, c, d, M[1], 3);
+		MD4_HH_SIMD(d, a, b, c, M[9], 9);
+		MD4_HH_SIMD(c, d, a, b, M[5], 11);
+		MD4_HH_SIMD(b, c, d, a, M[13], 15);
+		MD4_HH_SIMD(a, b, c, d, M[3], 3);
+		MD4_HH_SIMD(d, a, b, c, M[11], 9);
+		MD4_HH_SIMD(c, d, a, b, M[7], 11);
+		MD4_HH_SIMD(b, c, d, a, M[15], 15);
+
+		// 只有块数大于 i 的通道接受这一块的结果
+		uint32x4_t active = vcgtq_u32(n_blocks, vdupq_n_u32(i));
+		H[0] = vbslq_u32(active, vaddq_u32(H[0], a), H[0]);
+		H[1] = vbslq_u32(active, vaddq_u32(H[1], b), H[1]);
+		H[2] = vbslq_u32(active, vaddq_u32(H[2], c), H[2]);
+		H[3] = vbslq_u32(active, vaddq_u32(H[3], d), H[3]);
+	}
+	ThreadArena().rewind(arenaMark);
+
+	StoreLanes(H, MD4_DIGEST_WORDS, true, state);
+}
+
+/**
+ * SIMDMD4Hash_4: 四路并行 MD4
+ * @param inputs 输入
+ * @param[out] state 结果，每个口令 4 个 bit32
+ */
+void SIMDMD4Hash_4(string *inputs, bit32 *state)
+{
+	MD4Lanes(inputs, false, state);
+}
+
+/**
+ * SIMDNTLMHash_4: 四路并行 NTLM，即对 UTF-16LE 编码的口令计算 MD4
+ * 扩展在填充时用 NEON 完成（WidenUTF16），与 MD4 共用同一套运算
+ * @param inputs 输入
+ * @param[out] state 结果，每个口令 4 个 bit32
+ */
+void SIMDNTLMHash_4(string *inputs, bit32 *state)
+{
+	MD4Lanes(inputs, true, state);
+}
+
+/**
+ * SIMDSHA1Hash_4: 四路并行 SHA-1
+ * 消息字按大端读入，80 个扩展字在 16 个字的循环数组中就地计算
+ * @param inputs 输入
+ * @param[out] state 结果，每个口令 5 个 bit32
+ */
+void SIMDSHA1Hash_4(string *inputs, bit32 *state)
+{
+	int blocks[4];
+	int stride;
+	size_t arenaMark = ThreadArena().mark();
+	Byte *paddedData = PadLanes(inputs, false, true, blocks, stride);
+	int maxBlocks = max(max(blocks[0], blocks[1]), max(blocks[2], blocks[3]));
+	uint32x4_t n_blocks = {(uint32_t)blocks[0], (uint32_t)blocks[1], (uint32_t)blocks[2], (uint32_t)blocks[3]};
+
+	uint32x4_t H[5] = {vdupq_n_u32(0x67452301), vdupq_n_u32(0xefcdab89), vdupq_n_u32(0x98badcfe),
+					   vdupq_n_u32(0x10325476), vdupq_n_u32(0xc3d2e1f0)};
+
+	for (int i = 0; i < maxBlocks; i += 1) {
+		uint32x4_t W[16];
+		LoadWords(paddedData, stride, i, true, W);
+
+		uint32x4_t a = H[0], b = H[1], c = H[2], d = H[3], e = H[4];
+		for (int t = 0; t < 80; t++) {
+			if (t >= 16) {
+				uint32x4_t w = veorq_u32(veorq_u32(W[(t - 3) & 15], W[(t - 8) & 15]),
+										 veorq_u32(W[(t - 14) & 15], W[t & 15]));
+				W[t & 15] = ROTATELEFT_SIMD(w, 1);
+			}
+
+			uint32x4_t f;
+			bit32 k;
+			if (t < 20) {
+				f = SHA_CH_SIMD(b, c, d);
+				k = 0x5a827999;
+			}
+			else if (t < 40) {
+				f = H_SIMD(b, c, d);
+				k = 0x6ed9eba1;
+			}
+			else if (t < 60) {
+				f = SHA_MAJ_SIMD(b, c, d);
+				k = 0x8f1bbcdc;
+			}
+			else {
+				f = H_SIMD(b, c, d);
+				k = 0xca62c1d6;
+			}
+
+			uint32x4_t temp = vaddq_u32(vaddq_u32(ROTATELEFT_SIMD(a, 5), f),
+										vaddq_u32(vaddq_u32(e, W[t & 15]), vdupq_n_u32(k)));
+			e = d;
+			d = c;
+			c = ROTATELEFT_SIMD(b, 30);
+			b = a;
+			a = temp;
+		}
+
+		uint32x4_t active = vcgtq_u32(n_blocks, vdupq_n_u32(i));
+		H[0] = vbslq_u32(active, vaddq_u32(H[0], a), H[0]);
+		H[1] = vbslq_u32(active, vaddq_u32(H[1], b), H[1]);
+		H[2] = vbslq_u32(active, vaddq_u32(H[2], c), H[2]);
+		H[3] = vbslq_u32(active, vaddq_u32(H[3], d), H[3]);
+		H[4] = vbslq_u32(active, vaddq_u32(H[4], e), H[4]);
+	}
+	ThreadArena().rewind(arenaMark);
+
+	StoreLanes(H, SHA1_DIGEST_WORDS, false, state);
+}
+
+// SHA-256 的轮常数
+static const bit32 sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/**
+ * SIMDSHA256Hash_4: 四路并行 SHA-256
+ * @param inputs 输入
+ * @param[out] state 结果，每个口令 8 个 bit32
+ */
+void SIMDSHA256Hash_4(string *inputs, bit32 *state)
+{
+	int blocks[4];
+	int stride;
+	size_t arenaMark = ThreadArena().mark();
+	Byte *paddedData = PadLanes(inputs, false, true, blocks, stride);
+	int maxBlocks = max(max(blocks[0], blocks[1]), max(blocks[2], blocks[3]));
+	uint32x4_t n_blocks = {(uint32_t)blocks[0], (uint32_t)blocks[1], (uint32_t)blocks[2], (uint32_t)blocks[3]};
+
+	uint32x4_t H[8] = {vdupq_n_u32(0x6a09e667), vdupq_n_u32(0xbb67ae85), vdupq_n_u32(0x3c6ef372), vdupq_n_u32(0xa54ff53a),
+					   vdupq_n_u32(0x510e527f), vdupq_n_u32(0x9b05688c), vdupq_n_u32(0x1f83d9ab), vdupq_n_u32(0x5be0cd19)};
+
+	for (int i = 0; i < maxBlocks; i += 1) {
+		uint32x4_t W[16];
+		LoadWords(paddedData, stride, i, true, W);
+
+		uint32x4_t a = H[0], b = H[1], c = H[2], d = H[3], e = H[4], f = H[5], g = H[6], h = H[7];
+		for (int t = 0; t < 64; t++) {
+			if (t >= 16) {
+				W[t & 15] = vaddq_u32(vaddq_u32(SHA256_s1_SIMD(W[(t - 2) & 15]), W[(t - 7) & 15]),
+									  vaddq_u32(SHA256_s0_SIMD(W[(t - 15) & 15]), W[t & 15]));
+			}
+
+			uint32x4_t temp1 = vaddq_u32(vaddq_u32(h, SHA256_S1_SIMD(e)),
+										 vaddq_u32(vaddq_u32(SHA_CH_SIMD(e, f, g), vdupq_n_u32(sha256_k[t])), W[t & 15]));
+			uint32x4_t temp2 = vaddq_u32(SHA256_S0_SIMD(a), SHA_MAJ_SIMD(a, b, c));
+			h = g;
+			g = f;
+			f = e;
+			e = vaddq_u32(d, temp1);
+			d = c;
+			c = b;
+			b = a;
+			a = vaddq_u32(temp1, temp2);
+		}
+
+		uint32x4_t active = vcgtq_u32(n_blocks, vdupq_n_u32(i));
+		uint32x4_t result[8] = {a, b, c, d, e, f, g, h};
+		for (int w = 0; w < 8; w++) {
+			H[w] = vbslq_u32(active, vaddq_u32(H[w], result[w]), H[w]);
+		}
+	}
+	ThreadArena().rewind(arenaMark);
+
+	StoreLanes(H, SHA256_DIGEST_WORDS, false, state);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "md5.h"
+
+// MD5 以外的四路 SIMD 哈希：MD4 / NTLM、SHA-1、SHA-256
+// 接口与 SIMDMD5Hash_4 相同：一次处理 4 个口令，结果按口令依次写入 state，
+// 每个口令的结果按 setw(8) hex 依次输出即为常见的十六进制摘要
+// 与 SIMDMD5Hash_4 不同，各通道按自己的块数处理，长度相差较大的口令可以放在同一批
+
+// 各算法的摘要字数（bit32）
+#define MD4_DIGEST_WORDS 4
+#define SHA1_DIGEST_WORDS 5
+#define SHA256_DIGEST_WORDS 8
+
+// MD4 的三个基本函数，其中 F 与 MD5 相同，G 为多数函数
+#define MD4_G_SIMD(x, y, z) vorrq_u32(vandq_u32(x, y), vandq_u32(vorrq_u32(x, y), z))
+
+// MD4 的三轮运算（第一轮无常数，第二、三轮的常数分别为 0x5a827999、0x6ed9eba1）
+#define MD4_FF_SIMD(a, b, c, d, x, s) { \
+  a = ROTATELEFT_SIMD(vaddq_u32(vaddq_u32(a, F_SIMD(b, c, d)), x), s); \
+}
+
+#define MD4_GG_SIMD(a, b, c, d, x, s) { \
+  a = ROTATELEFT_SIMD(vaddq_u32(vaddq_u32(a, MD4_G_SIMD(b, c, d)), vaddq_u32(x, vdupq_n_u32(0x5a827999))), s); \
+}
+
+#define MD4_HH_SIMD(a, b, c, d, x, s) { \
+  a = ROTATELEFT_SIMD(vaddq_u32(vaddq_u32(a, H_SIMD(b, c, d)), vaddq_u32(x, vdupq_n_u32(0x6ed9eba1))), s); \
+}
+
+// 循环右移（SHA-256 使用）
+#define ROTATERIGHT_SIMD(num, n) \
+    vorrq_u32(vshrq_n_u32((num), (n)), vshlq_n_u32((num), (32 - (n))))
+
+// SHA 系列的选择函数与多数函数
+#define SHA_CH_SIMD(x, y, z) veorq_u32(vandq_u32(x, y), vandq_u32(vmvnq_u32(x), z))
+#define SHA_MAJ_SIMD(x, y, z) vorrq_u32(vandq_u32(x, y), vandq_u32(vorrq_u32(x, y), z))
+
+// SHA-256 的 Σ0, Σ1（压缩函数）与 σ0, σ1（消息扩展）
+#define SHA256_S0_SIMD(x) veorq_u32(ROTATERIGHT_SIMD(x, 2), veorq_u32(ROTATERIGHT_SIMD(x, 13), ROTATERIGHT_SIMD(x, 22)))
+#define SHA256_S1_SIMD(x) veorq_u32(ROTATERIGHT_SIMD(x, 6), veorq_u32(ROTATERIGHT_SIMD(x, 11), ROTATERIGHT_SIMD(x, 25)))
+#define SHA256_s0_SIMD(x) veorq_u32(ROTATERIGHT_SIMD(x, 7), veorq_u32(ROTATERIGHT_SIMD(x, 18), vshrq_n_u32(x, 3)))
+#define SHA256_s1_SIMD(x) veorq_u32(ROTATERIGHT_SIMD(x, 17), veorq_u32(ROTATERIGHT_SIMD(x, 19), vshrq_n_u32(x, 10)))
+
+// MD4(input)，state 每个口令 4 个 bit32
+void SIMDMD4Hash_4(string *input, bit32 *state);
+
+// NTLM = MD4(UTF-16LE(input))，口令按单字节字符（ASCII / Latin-1）扩展为 UTF-16LE，state 每个口令 4 个 bit32
+void SIMDNTLMHash_4(string *input, bit32 *state);
+
+// SHA-1(input)，state 每个口令 5 个 bit32
+void SIMDSHA1Hash_4(string *input, bit32 *state);
+
+// SHA-256(input)，state 每个口令 8 个 bit32
+void SIMDSHA256Hash_4(string *input, bit32 *state);
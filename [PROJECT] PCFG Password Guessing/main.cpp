@@ -153,23 +153,290 @@
 
 
 // 以下是 MPI 专用的 main 函数
+// 编译指令如下
+// mpicxx main.cpp train.cpp guessing.cpp md5.cpp hashes.cpp crack.cpp curve.cpp writer.cpp corpus.cpp arena.cpp comm.cpp checkpoint.cpp estimator.cpp -o main -O2 -fopenmp
 
 
 #include "PCFG.h"
 #include <mpi.h>
 #include <fstream>
 #include "md5.h"
+#include "crack.h"
+#include "curve.h"
+#include "writer.h"
+#include "corpus.h"
+#include "comm.h"
+#include "checkpoint.h"
+#include "estimator.h"
 #include <iomanip>
-#include <unordered_set>
 #include <vector>
 #include <iostream>
+#include <sstream>
 #include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
 using namespace std;
 using namespace chrono;
 
+/**
+ * ReportHit: 输出一个命中目标哈希的口令，以及它的猜测序号和来源 PT
+ * 猜测序号为 position + 下标，按本进程计：多进程时 guesses 只是本进程生成的部分，
+ * 而 history 是所有进程的合计（复制运行时还是各进程重复生成的猜测数之和），不能用作序号
+ * 命中记录先写入 out，由 GatherHits 在检查点统一汇总到 0 号进程输出
+ * @param out 本进程的命中记录缓冲区
+ * @param q 优先队列（用于查找来源 PT）
+ * @param index 口令在 q.guesses 中的下标
+ * @param position 本进程之前已经清空的猜测数
+ * @param digest 口令的哈希
+ * @param rank 进程号
+ * @param curve 破解曲线记录器，命中记入主线程（0 号）的缓冲区
+ * @param salt 命中时使用的盐值（不加盐的方案为空）
+ */
+static void ReportHit(ostream &out, const PriorityQueue &q, size_t index, long long position, const bit32 *digest, int rank,
+                      CrackCurve &curve, const string &salt = "")
+{
+    out << "[hit] " << FormatDigest(digest) << " " << q.guesses[index];
+    if (salt != "") {
+        out << " salt " << salt;
+    }
+    out << " guess #" << position + index;
+    const GuessSpan *span = q.FindSpan(index);
+    curve.record(0, position + index, HIT_TARGET, span != NULL ? span->pattern : "", q.guesses[index]);
+    if (span != NULL) {
+        out << " PT " << span->pattern << " [";
+        for (size_t i = 0; i < span->curr_indices.size(); i++) {
+            out << (i ? "," : "") << span->curr_indices[i];
+        }
+        out << "]";
+    }
+    out << " (rank " << rank << ")" << endl;
+}
+
+/**
+ * GatherHits: 把各进程的命中记录按进程号顺序收集到 0 号进程
+ * 所有进程都必须调用（集合通信）
+ * @param local 本进程的命中记录
+ * @param rank 进程号
+ * @param size 进程数
+ * @param comm 通信子
+ * @return 0 号进程返回所有进程的命中记录，其余进程返回空串
+ */
+static string GatherHits(const string &local, int rank, int size, MPI_Comm comm)
+{
+    int length = local.size();
+    vector<int> lengths(rank == 0 ? size : 0);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, comm);
+
+    vector<int> displs(lengths.size(), 0);
+    int total = 0;
+    for (size_t r = 0; r < lengths.size(); r++) {
+        displs[r] = total;
+        total += lengths[r];
+    }
+    string all(total, '\0');
+    MPI_Gatherv(local.data(), length, MPI_CHAR, &all[0], lengths.data(), displs.data(), MPI_CHAR, 0, comm);
+    return all;
+}
+
+/**
+ * TakeHits: 取出并清空本进程缓冲的命中记录
+ * 各进程生成相同猜测时（replicated）只保留 0 号进程的记录，避免重复输出
+ */
+static string TakeHits(ostringstream &hits, int rank, bool replicated)
+{
+    string local = (replicated && rank != 0) ? "" : hits.str();
+    hits.str("");
+    return local;
+}
+
+// 每个进程的统计量，全部用 double 存放，以便整体作为一个 MPI_DOUBLE 数组收集
+typedef struct {
+    double guess_time;   // 生成和哈希的总时长（从开始生成到结束）
+    double hash_time;    // 哈希与比对的时长
+    double train_time;   // 训练时长
+    double generated;    // 本进程生成的猜测数
+    double hashed;       // 本进程哈希并比对过的猜测数
+    double cracked;      // 本进程命中测试集的猜测数
+    double hash_cracked; // 本进程命中目标哈希的猜测数
+} rankStats_t;
+
+const int RANK_STATS_FIELDS = sizeof(rankStats_t) / sizeof(double);
+
+/**
+ * ReportStats: 把各进程的计时和计数收集到 0 号进程，输出合计的破解数、总吞吐量和各进程之间的负载不均衡度
+ * 所有进程生成相同猜测的方法（replicated）只计 0 号进程的命中，避免重复计数
+ * 所有进程都必须调用（集合通信）
+ * @param local 本进程的统计量
+ * @param rank 进程号
+ * @param size 进程数
+ * @param replicated 各进程是否生成完全相同的猜测
+ * @param target_count 目标哈希数（为 0 表示没有加载目标）
+ */
+static void ReportStats(const rankStats_t &local, int rank, int size, bool replicated, int target_count)
+{
+    vector<rankStats_t> all(rank == 0 ? size : 0);
+    MPI_Gather((void *)&local, RANK_STATS_FIELDS, MPI_DOUBLE, all.data(), RANK_STATS_FIELDS, MPI_DOUBLE,
+               0, MPI_COMM_WORLD);
+    if (rank != 0) {
+        return;
+    }
+
+    // 墙钟时间取各进程的最大值；计数取和（replicated 时只取 0 号进程）
+    rankStats_t total = {0, 0, 0, 0, 0, 0, 0};
+    for (int r = 0; r < size; r++) {
+        total.guess_time = max(total.guess_time, all[r].guess_time);
+        total.hash_time = max(total.hash_time, all[r].hash_time);
+        total.train_time = max(total.train_time, all[r].train_time);
+        if (!replicated || r == 0) {
+            total.generated += all[r].generated;
+            total.hashed += all[r].hashed;
+            total.cracked += all[r].cracked;
+            total.hash_cracked += all[r].hash_cracked;
+        }
+    }
+
+    cout << "=== MPI Timing Results (" << size << " processes) ===" << endl;
+    cout << "Guess time: " << total.guess_time << " seconds" << endl;
+    cout << "Hash time: " << total.hash_time << "seconds" << endl;
+    cout << "Train time: " << total.train_time << " seconds" << endl;
+    cout << "Cracked: " << (long long)total.cracked << endl;
+    if (target_count > 0) {
+        cout << "Hash cracked: " << (long long)total.hash_cracked << " / " << target_count << endl;
+    }
+    if (size == 1) {
+        return;
+    }
+
+    // 各进程的明细；只统计实际生成了猜测的进程（主从调度的主进程不生成）
+    int active = 0;
+    double max_generated = 0, sum_hash_time = 0, max_hash_time = 0;
+    for (int r = 0; r < size; r++) {
+        const rankStats_t &s = all[r];
+        cout << "Rank " << r << ": generated " << (long long)s.generated << ", hashed " << (long long)s.hashed
+             << ", hash time " << s.hash_time << " seconds";
+        if (s.hash_time > 0) {
+            cout << " (" << s.hashed / s.hash_time / 1e6 << " MH/s)";
+        }
+        cout << ", cracked " << (long long)s.cracked << endl;
+        if (s.generated > 0) {
+            active += 1;
+            max_generated = max(max_generated, s.generated);
+            sum_hash_time += s.hash_time;
+            max_hash_time = max(max_hash_time, s.hash_time);
+        }
+    }
+    // replicated 时每个进程都相当于一次单进程运行，计数必须与 0 号进程相同，否则合计（只取 0 号进程）不可信
+    if (replicated) {
+        for (int r = 1; r < size; r++) {
+            if (all[r].hashed != all[0].hashed || all[r].cracked != all[0].cracked
+                || all[r].hash_cracked != all[0].hash_cracked) {
+                cout << "Warning: rank " << r << " disagrees with rank 0 on a replicated run" << endl;
+            }
+        }
+    }
+
+    cout << "Aggregate: " << (long long)total.generated << " guesses";
+    if (total.guess_time > 0) {
+        cout << ", " << total.generated / total.guess_time / 1e6 << " M guesses/s";
+    }
+    if (total.hash_time > 0) {
+        cout << ", " << total.hashed / total.hash_time / 1e6 << " MH/s";
+    }
+    cout << endl;
+    // 不均衡度：最大值 / 平均值，1 表示完全均衡
+    if (active > 0 && !replicated) {
+        double avg_generated = total.generated / active;
+        double avg_hash_time = sum_hash_time / active;
+        cout << "Imbalance: guesses " << (avg_generated > 0 ? max_generated / avg_generated : 1)
+             << ", hash time " << (avg_hash_time > 0 ? max_hash_time / avg_hash_time : 1) << endl;
+    }
+}
+
+/**
+ * StreamMode: 流式模式的生成循环
+ * 每生成 STREAM_BATCH_GUESSES 个猜测就写出并清空，写出阻塞（管道满）时不再展开新的 PT
+ * @param q 已初始化的优先队列
+ * @param fd 输出的文件描述符
+ * @param limit 最多写出的猜测数，为负时不限制
+ * @return 写出的猜测数
+ */
+static long long StreamMode(PriorityQueue &q, int fd, long long limit)
+{
+    long long streamed = 0;
+    while (!q.priority.empty())
+    {
+        q.PopBatch(STREAM_BATCH_GUESSES);
+        if (limit >= 0 && streamed + (long long)q.guesses.size() >= limit) {
+            // 达到上限：截掉多余的猜测，写出后结束
+            q.TruncateGuesses(limit - streamed);
+            break;
+        }
+        if (q.guesses.size() >= STREAM_BATCH_GUESSES) {
+            if (!StreamGuesses(fd, q.guesses)) {
+                // 消费者已关闭管道
+                return streamed;
+            }
+            streamed += q.guesses.size();
+            q.ClearGuesses();
+        }
+    }
+    if (StreamGuesses(fd, q.guesses)) {
+        streamed += q.guesses.size();
+    }
+    q.ClearGuesses();
+    return streamed;
+}
+
+/**
+ * RecordMode: 录制模式的生成循环，生成到 limit 个猜测为止
+ * @param q 已初始化的优先队列
+ * @param recorder 语料记录器
+ * @param limit 录制的猜测数
+ */
+static void RecordMode(PriorityQueue &q, CorpusRecorder &recorder, size_t limit)
+{
+    while (!q.priority.empty())
+    {
+        q.PopBatch(STREAM_BATCH_GUESSES);
+        if (q.guesses.size() >= STREAM_BATCH_GUESSES) {
+            bool full = recorder.append(q.guesses, limit);
+            q.ClearGuesses();
+            if (full) {
+                return;
+            }
+        }
+    }
+    recorder.append(q.guesses, limit);
+    q.ClearGuesses();
+}
+
+/**
+ * CheckpointPath: 本进程的检查点文件路径，多进程时前缀后加 .<rank>
+ */
+static string CheckpointPath(const string &prefix, int rank, int size)
+{
+    return size > 1 ? prefix + "." + to_string(rank) : prefix;
+}
+
+/**
+ * GlobalWatermark: 分布式队列的全局水位线，即所有进程本地队首概率的最大值（集合通信，所有进程都要调用）
+ * @param q 本地优先队列
+ * @return 水位线，所有队列都为空时为 0
+ */
+static float GlobalWatermark(const PriorityQueue &q)
+{
+    float local = q.FrontProb();
+    float global = 0;
+    MPI_Allreduce(&local, &global, 1, MPI_FLOAT, MPI_MAX, MPI_COMM_WORLD);
+    return global;
+}
+
 int main(int argc, char *argv[])
 {
-    MPI_Init(&argc, &argv);
+    // 通信线程与主线程同时调用 MPI，需要 MPI_THREAD_MULTIPLE；不支持时通信线程不启动
+    int thread_level;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &thread_level);
     int rank, size;
 
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -177,7 +444,190 @@ int main(int argc, char *argv[])
 
     double time_train = 0.0, time_guess = 0.0, time_hash = 0.0;
 
+    // 命令行参数
+    // --backend=<name>: 生成方法，可选 serial / pthread / pthread_pool / openmp / mpi / mpi_openmp / adaptive /
+    //                   openmp_persistent（常驻并行区域，一次处理多个 PT），默认 mpi_openmp
+    // 注意：除 mpi / mpi_openmp 外，其余方法在多进程运行时每个进程都会生成全部猜测（--distributed 时各进程只生成自己的子树）
+    // --targets=<file>: 目标哈希文件（每行一个十六进制 MD5），给定时将生成口令的哈希与之比对，报告命中的口令、猜测序号和来源 PT
+    string backend_name = "mpi_openmp";
+    // --scheme=<name>: 目标哈希的计算方式，可选 md5 / salt_pw / pw_salt / md5_md5 / md4 / ntlm / sha1 / sha256，默认 md5；
+    //                  加盐方案的目标文件每行为 "摘要:盐值"；SHA 系列只比对（和输出）摘要的前 128 位
+    string targets_path = "";
+    string scheme_name = "md5";
+    // --curve=<prefix>: 输出破解曲线（<prefix>.csv）、各 PT 的命中统计（<prefix>_pt.csv）和全部命中（<prefix>.json），
+    //                   多进程时每个进程输出自己的部分，文件名前缀后加 .<rank>
+    string curve_prefix = "";
+    // --output=<file>: 将生成的猜测写入文件（"-" 为标准输出），多进程时文件名后加 .<rank>
+    // --output-format=text|binary: 输出格式，默认 text（每行一个口令）；binary 为 2 字节长度 + 口令
+    // --output-digests: 同时输出每个口令的摘要（text 为 "口令\t十六进制摘要"，binary 为口令后的 16 字节）
+    string output_path = "";
+    int output_format = WRITER_TEXT;
+    bool output_digests = false;
+    // --stream=<file|->: 流式模式，不加载测试集、不计算哈希，按概率顺序将猜测逐行写到标准输出或 FIFO，
+    //                    直到队列为空或消费者关闭管道。管道满时写入阻塞，生成随之暂停，
+    //                    内存中至多保留 STREAM_BATCH_GUESSES 个猜测加上一个 PT 的一次展开（MAX_BATCH_GUESSES）
+    string stream_path = "";
+    // --record=<file>:   录制模式，不加载测试集、不计算哈希，将前 --record-limit 个（默认一千万）猜测写成语料文件，
+    //                    供 bench 回放（见 bench.cpp）
+    string record_path = "";
+    size_t record_limit = 10000000;
+    // --distributed: 分布式队列，各进程按初始 PT 划分 PT 空间，各自维护本地队列，每一步（DIST_STEP_GUESSES 个猜测）
+    //                只交换一次队首概率（水位线）和猜测数；猜测不在进程间划分，生成方法应为非 MPI 方法（MPI 方法改用 openmp）
+    bool distributed = false;
+    // --master-worker: 主从调度，0 号进程独占优先队列，按请求向其他进程下发任务（小 PT 合并、大 PT 切分），
+    //                  生成的猜测留在各工作进程中比对；至少需要 2 个进程
+    bool master_worker = false;
+    // --checkpoint=<prefix>: 每生成 --checkpoint-interval 个猜测（所有进程合计，默认 CHECKPOINT_GUESSES）写一次检查点：
+    //                        各进程的队列写到 <prefix>.<rank>（单进程时为 <prefix>），模型镜像写到 <prefix>.model；
+    //                        生成线程只编码队列，文件由后台线程写出
+    // --resume=<prefix>: 从检查点恢复：读入模型镜像（不重新训练）和各进程的队列，从检查点处继续生成，
+    //                    之后的输出与不中断时完全相同；进程数和生成方法须与写检查点时相同，不支持主从调度
+    string checkpoint_prefix = "";
+    long long checkpoint_interval = CHECKPOINT_GUESSES;
+    string resume_prefix = "";
+    // --skip=<S> --limit=<L>: 只枚举按概率顺序的第 [S, S + L) 个猜测（单进程）。前 S 个猜测只计数、不生成
+    //                         （PriorityQueue::SkipGuesses），多台机器可以不经任何协调各自枚举同一次运行的不相交区间；
+    //                         --limit 省略时为 generate_n。可以与 --resume 一起使用：从检查点处开始快进，
+    //                         检查点的位置不能超过 S。也适用于 --stream（省略 --limit 时不限制）和 --record
+    long long keyspace_skip = 0;
+    long long keyspace_limit = -1;
+    // --threshold=<p>: 概率阈值枚举，不使用优先队列，生成概率不低于 p 的全部猜测（不按概率排序），生成完毕后结束；
+    //                  深度优先搜索各 PT 的 value 类组合并按累积概率剪枝，各初始 PT 和各 PT 切片由线程并行处理，
+    //                  多进程时 PT 轮流分给各进程。生成使用 OpenMP（忽略 --backend），不能与区间、检查点、分布式队列或主从调度一起使用
+    float threshold = 0;
+    // --estimate=<file>: 估计模式，不生成猜测：从模型中采样 --estimate-samples 个（默认 ESTIMATOR_SAMPLES）猜测，
+    //                    建立蒙特卡洛排名表，然后多线程估计文件中每个口令（每行一个）的概率和猜测序号（按优先队列的输出顺序），
+    //                    输出 "口令\t概率\t估计的猜测序号"（模型生成不了的口令为 -1）
+    string estimate_path = "";
+    size_t estimate_samples = ESTIMATOR_SAMPLES;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--backend=", 0) == 0) {
+            backend_name = arg.substr(strlen("--backend="));
+        }
+        if (arg.rfind("--targets=", 0) == 0) {
+            targets_path = arg.substr(strlen("--targets="));
+        }
+        if (arg.rfind("--record=", 0) == 0) {
+            record_path = arg.substr(strlen("--record="));
+        }
+        if (arg.rfind("--record-limit=", 0) == 0) {
+            record_limit = strtoull(arg.c_str() + strlen("--record-limit="), NULL, 10);
+        }
+        if (arg == "--master-worker") {
+            master_worker = true;
+        }
+        if (arg == "--distributed") {
+            distributed = true;
+        }
+        if (arg.rfind("--stream=", 0) == 0) {
+            stream_path = arg.substr(strlen("--stream="));
+        }
+        if (arg.rfind("--output=", 0) == 0) {
+            output_path = arg.substr(strlen("--output="));
+        }
+        if (arg == "--output-format=binary") {
+            output_format = WRITER_BINARY;
+        }
+        if (arg == "--output-digests") {
+            output_digests = true;
+        }
+        if (arg.rfind("--curve=", 0) == 0) {
+            curve_prefix = arg.substr(strlen("--curve="));
+        }
+        if (arg.rfind("--checkpoint=", 0) == 0) {
+            checkpoint_prefix = arg.substr(strlen("--checkpoint="));
+        }
+        if (arg.rfind("--checkpoint-interval=", 0) == 0) {
+            checkpoint_interval = strtoll(arg.c_str() + strlen("--checkpoint-interval="), NULL, 10);
+        }
+        if (arg.rfind("--skip=", 0) == 0) {
+            keyspace_skip = strtoll(arg.c_str() + strlen("--skip="), NULL, 10);
+        }
+        if (arg.rfind("--limit=", 0) == 0) {
+            keyspace_limit = strtoll(arg.c_str() + strlen("--limit="), NULL, 10);
+        }
+        if (arg.rfind("--estimate=", 0) == 0) {
+            estimate_path = arg.substr(strlen("--estimate="));
+        }
+        if (arg.rfind("--estimate-samples=", 0) == 0) {
+            estimate_samples = strtoull(arg.c_str() + strlen("--estimate-samples="), NULL, 10);
+        }
+        if (arg.rfind("--threshold=", 0) == 0) {
+            threshold = strtof(arg.c_str() + strlen("--threshold="), NULL);
+        }
+        if (arg.rfind("--resume=", 0) == 0) {
+            resume_prefix = arg.substr(strlen("--resume="));
+        }
+        if (arg.rfind("--scheme=", 0) == 0) {
+            scheme_name = arg.substr(strlen("--scheme="));
+        }
+    }
+
+    // 猜测区间：各台机器各自单进程运行，区间按全局的概率顺序计
+    bool keyspace = keyspace_skip > 0 || keyspace_limit >= 0;
+    if (keyspace && (size > 1 || keyspace_skip < 0)) {
+        if (rank == 0) {
+            cerr << "--skip / --limit run on a single process and need a non-negative skip" << endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (threshold > 0 && (keyspace || distributed || master_worker || checkpoint_prefix != "" || resume_prefix != ""
+                          || stream_path != "" || record_path != "")) {
+        if (rank == 0) {
+            cerr << "--threshold cannot be combined with --skip/--limit, --distributed, --master-worker, "
+                 << "--checkpoint, --resume, --stream or --record" << endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // 流式模式：标准输出留给猜测，其余的日志输出改到标准错误
+    int stream_fd = -1;
+    if (stream_path != "") {
+        if (size > 1) {
+            if (rank == 0) {
+                cerr << "Stream mode runs on a single process" << endl;
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        if (stream_path == "-") {
+            stream_fd = dup(STDOUT_FILENO);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+        else {
+            // 打开 FIFO 时会阻塞到消费者打开读端为止；普通文件先截断，避免上次更长的输出残留在末尾
+            stream_fd = open(stream_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (stream_fd < 0) {
+            cerr << "Cannot open stream output: " << stream_path << endl;
+            MPI_Finalize();
+            return 1;
+        }
+        // 消费者提前退出时，写入返回 EPIPE 而不是终止进程
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    SchemeHasher hasher;
+    if (!hasher.setScheme(scheme_name)) {
+        if (rank == 0) {
+            cerr << "Unknown scheme: " << scheme_name << endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
     PriorityQueue q;
+    if (!q.SetBackend(backend_name)) {
+        if (rank == 0) {
+            cerr << "Unknown backend: " << backend_name << endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
 
     
 
@@ -187,8 +637,26 @@ int main(int argc, char *argv[])
         cout << "Starting model training..." << endl;
     }
     
-    q.m.train("/guessdata/Rockyou-singleLined-full.txt");
-    q.m.order();
+    // 每个节点只训练一次，模型镜像放在节点内共享的窗口中，同一节点的进程共用
+    // 从检查点恢复时直接读入检查点中的模型镜像
+    if (resume_prefix != "") {
+        int loaded = q.m.LoadImage(resume_prefix + ".model");
+        int all_loaded = 0;
+        MPI_Allreduce(&loaded, &all_loaded, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (!all_loaded) {
+            if (rank == 0) {
+                cerr << "Cannot load model image: " << resume_prefix << ".model" << endl;
+            }
+            MPI_Finalize();
+            return 1;
+        }
+    }
+    else {
+        q.m.TrainShared("/guessdata/Rockyou-singleLined-full.txt");
+    }
+    if (checkpoint_prefix != "" && rank == 0 && !q.m.SaveImage(checkpoint_prefix + ".model")) {
+        cerr << "Cannot write model image: " << checkpoint_prefix << ".model" << endl;
+    }
     
     double mpi_time_train_end = MPI_Wtime();
     time_train = mpi_time_train_end - mpi_time_train_start;
@@ -200,24 +668,205 @@ int main(int argc, char *argv[])
     // 等待所有进程完成训练
     MPI_Barrier(MPI_COMM_WORLD);
 
-    // 加载一些测试数据
-    unordered_set<std::string> test_set;
-    ifstream test_data("/guessdata/Rockyou-singleLined-full.txt");
-    int test_count=0;
-    string pw;
-    while(test_data>>pw)
-    {   
-        test_count+=1;
-        test_set.insert(pw);
-        if (test_count>=1000000)
-        {
-            break;
+    if (record_path != "") {
+        q.init();
+        if (q.backend == GEN_PTHREAD_POOL || q.backend == GEN_ADAPTIVE) {
+            initThreadPool();
+        }
+        if (rank == 0) {
+            CorpusRecorder recorder;
+            q.SkipGuesses(keyspace_skip);
+            RecordMode(q, recorder, keyspace_limit >= 0 ? keyspace_limit : record_limit);
+            if (!recorder.save(record_path)) {
+                cerr << "Cannot write corpus: " << record_path << endl;
+            }
+            cout << "Recorded " << recorder.size() << " guesses to " << record_path << endl;
+        }
+        deleteThreadPool();
+        q.m.ReleaseShared();
+        MPI_Finalize();
+        return 0;
+    }
+
+    if (estimate_path != "") {
+        q.init();
+        if (rank == 0) {
+            double build_start = MPI_Wtime();
+            GuessEstimator estimator;
+            estimator.build(q, estimate_samples, 1, q.gen_threads);
+            double build_time = MPI_Wtime() - build_start;
+
+            vector<string> pws;
+            ifstream in(estimate_path);
+            string line;
+            while (getline(in, line)) {
+                pws.push_back(line);
+            }
+            double score_start = MPI_Wtime();
+            vector<double> probs, ranks;
+            estimator.estimateAll(pws, probs, ranks, q.gen_threads);
+            double score_time = MPI_Wtime() - score_start;
+
+            for (size_t i = 0; i < pws.size(); i++) {
+                cout << pws[i] << "\t" << probs[i] << "\t" << fixed << setprecision(0) << ranks[i]
+                     << defaultfloat << setprecision(6) << "\n";
+            }
+            cerr << "Estimator: " << estimator.samples() << " samples in " << build_time << " seconds; scored "
+                 << pws.size() << " passwords in " << score_time << " seconds ("
+                 << (pws.empty() ? 0 : score_time * 1e6 / pws.size()) << " us each)" << endl;
         }
+        q.m.ReleaseShared();
+        MPI_Finalize();
+        return 0;
     }
+
+    if (stream_fd >= 0) {
+        q.init();
+        if (q.backend == GEN_PTHREAD_POOL || q.backend == GEN_ADAPTIVE) {
+            initThreadPool();
+        }
+        q.SkipGuesses(keyspace_skip);
+        long long streamed = StreamMode(q, stream_fd, keyspace_limit);
+        close(stream_fd);
+        cerr << "Streamed " << streamed << " guesses" << endl;
+        deleteThreadPool();
+        q.m.ReleaseShared();
+        MPI_Finalize();
+        return 0;
+    }
+
+    // 加载一些测试数据
+    // 测试集用 PasswordSet（分块布隆过滤器 + 开放寻址指纹表）存储，支持批量预取查询
+    PasswordSet test_set;
+    test_set.load("/guessdata/Rockyou-singleLined-full.txt", 1000000);
     int cracked=0;
 
+    // 破解曲线：测试集的比对由多个线程完成，每个线程一个缓冲区
+    CrackCurve curve;
+    curve.init(q.gen_threads);
+
+    // 加载目标哈希
+    TargetSet targets;
+    int hash_cracked = 0;
+    // 本进程的命中记录，检查点时汇总到 0 号进程输出
+    ostringstream hit_log;
+    if (targets_path != "") {
+        int target_count = targets.load(targets_path);
+        if (rank == 0) {
+            cout << "Loaded " << target_count << " target hashes, " << targets.salts.size() << " salts" << endl;
+        }
+    }
+    hasher.setSalts(targets.salts);
+    if (hasher.salted() && hasher.salts.empty() && rank == 0) {
+        cerr << "Scheme " << scheme_name << " needs salted targets (digest:salt)" << endl;
+    }
+
+    // 猜测输出流
+    GuessWriter writer;
+    if (output_path != "") {
+        string path = (size > 1 && output_path != "-") ? output_path + "." + to_string(rank) : output_path;
+        if (!writer.open(path, output_format, output_digests) && rank == 0) {
+            cerr << "Cannot open output: " << path << endl;
+        }
+    }
+
+    // 目标很少时使用早退破解内核：预先由目标摘要反推出中间状态，哈希只需计算到比对的那一步
+    vector<md5Target_t> early_targets;
+    // 需要输出摘要时不能使用早退内核（它不计算完整的摘要）
+    if (hasher.scheme == SCHEME_MD5 && targets.size() > 0 && targets.size() <= CRACK_EARLY_MAX_TARGETS
+        && !(writer.isOpen() && writer.withDigest())) {
+        early_targets.resize(targets.size());
+        for (size_t t = 0; t < targets.size(); t++) {
+            MD5ReverseTarget(targets.list()[t].w, early_targets[t]);
+        }
+    }
+
     q.init();
 
+    if (master_worker && (size < 2 || distributed || checkpoint_prefix != "" || resume_prefix != "")) {
+        if (rank == 0) {
+            cerr << "Master/worker mode needs at least 2 processes and cannot be combined with --distributed, "
+                 << "--checkpoint or --resume" << endl;
+        }
+        q.m.ReleaseShared();
+        MPI_Finalize();
+        return 1;
+    }
+
+    // 分布式队列：本进程只保留自己负责的子树；MPI 方法会把每个 PT 的猜测再划分一次，这里改用本地的 OpenMP 方法
+    // openmp_persistent 不划分猜测，DistributedStep 按水位线逐个 PT 推进，经 PopNext 走它注册的 openmp 展开
+    if (distributed) {
+        if (q.Partitioned()) {
+            q.SetBackend("openmp");
+            if (rank == 0) {
+                cout << "Distributed queue: using backend openmp instead of " << backend_name << endl;
+            }
+        }
+        // 从检查点恢复时各进程的队列已经是划分之后的
+        if (resume_prefix == "") {
+            q.PartitionRoots(rank, size);
+        }
+    }
+
+    // 概率阈值枚举：搜索出概率不低于阈值的全部 PT
+    if (threshold > 0) {
+        double plan_start = MPI_Wtime();
+        q.ThresholdPlan(threshold, rank, size);
+        long long units = q.ThresholdUnits(), total = q.ThresholdGuesses();
+        long long all_units = 0, all_total = 0;
+        MPI_Reduce(&units, &all_units, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&total, &all_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            cout << "Threshold " << threshold << ": " << all_units << " PTs, " << all_total << " guesses (search "
+                 << MPI_Wtime() - plan_start << " seconds)" << endl;
+        }
+    }
+
+    // 从检查点恢复队列：所有进程都必须成功，且读到的是同一个检查点（history 相同）
+    checkpointHeader_t resume_header = {};
+    int checkpoint_backend = q.backend;
+    if (resume_prefix != "") {
+        vector<char> state;
+        string path = CheckpointPath(resume_prefix, rank, size);
+        int ok = LoadCheckpoint(path, resume_header, state) && resume_header.rank == rank
+                 && resume_header.size == size && resume_header.backend == checkpoint_backend
+                 && resume_header.distributed == distributed && q.LoadState(state.data(), state.size());
+        int all_ok = 0;
+        long long min_history = 0, max_history = 0;
+        long long history = resume_header.history;
+        MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        MPI_Allreduce(&history, &min_history, 1, MPI_LONG_LONG, MPI_MIN, MPI_COMM_WORLD);
+        MPI_Allreduce(&history, &max_history, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+        if (!all_ok || min_history != max_history) {
+            if (!ok) {
+                cerr << "Cannot resume from " << path << " (missing, corrupt, or written with a different "
+                     << "process count / backend / mode)" << endl;
+            }
+            else if (rank == 0 && min_history != max_history) {
+                cerr << "Checkpoint files are from different checkpoints" << endl;
+            }
+            q.m.ReleaseShared();
+            MPI_Finalize();
+            return 1;
+        }
+        if (rank == 0) {
+            cout << "Resumed from " << resume_prefix << " at guess " << resume_header.history << endl;
+        }
+    }
+
+    // 线程池方法需要先创建线程池；自适应方法在启动时标定本机上各方法的参数和吞吐量
+    if (q.backend == GEN_PTHREAD_POOL || q.backend == GEN_ADAPTIVE) {
+        initThreadPool();
+    }
+    if (q.backend == GEN_ADAPTIVE) {
+        q.CalibrateBackends();
+        if (rank == 0) {
+            cout << "Calibrated: omp threads " << q.gen_threads << ", pool threads " << q.pool_threads
+                 << ", pool chunk " << q.pool_chunk_size
+                 << ", pool serial threshold " << q.pool_serial_threshold << endl;
+        }
+    }
+
     // 广播模型数据给其他进程（假设模型支持广播，如果不支持可以先跳过）
     // 如果模型太复杂，可以考虑文件共享方式，当前我们假设只在rank 0生成猜测。
 
@@ -226,54 +875,162 @@ int main(int argc, char *argv[])
         cout << "here" << endl;
     }
 
-    int curr_num = 0;
+    long long curr_num = 0;
+    // 本进程哈希并比对过的猜测数（history 是所有进程的合计）
+    long long local_hashed = 0;
+    // 本进程的猜测序号：本进程生成并处理完的猜测数（含 --skip 跳过的），命中报告的猜测序号按它计
+    long long position = 0;
+    // 各进程的队列完全相同、且方法不划分猜测时，每个进程生成的猜测相同，汇总时只计 0 号进程
+    bool replicated = size > 1 && !distributed && !master_worker && threshold <= 0 && !q.Partitioned();
+
+    // 通信线程：检查点的汇总和主从调度的任务请求在后台进行，生成和哈希不等待通信
+    CommThread comm_thread;
+    comm_thread.start(MPI_COMM_WORLD);
+    q.comm_thread = &comm_thread;
+    string checkpoint_report;   // 通信线程汇总的上一个检查点的结果（只在 0 号进程非空）
+    if (rank == 0) {
+        cout << "Communication thread: " << (comm_thread.threaded() ? "on" : "off (no MPI_THREAD_MULTIPLE)") << endl;
+    }
 
     double mpi_time_guess_start = MPI_Wtime();
 
-    int history = 0;
+    long long history = 0;
+
+    // 检查点：恢复时从检查点中的计数继续
+    if (resume_prefix != "") {
+        history = resume_header.history;
+        cracked = resume_header.cracked;
+        hash_cracked = resume_header.hash_cracked;
+        local_hashed = resume_header.hashed;
+        position = resume_header.position;
+    }
+
+    // 在此处更改实验生成的猜测上限
+    long long generate_n = 10000000;
+
+    // 猜测区间 [keyspace_skip, keyspace_end)：从当前位置（开头或检查点）快进到区间起点，
+    // 此后 history 按全局的猜测序号计；生成到区间终点时截掉多余的猜测，处理完后结束
+    long long keyspace_end = 0;
+    if (keyspace) {
+        if (keyspace_skip < history) {
+            cerr << "Checkpoint at guess " << history << " is past --skip=" << keyspace_skip << endl;
+            q.m.ReleaseShared();
+            MPI_Finalize();
+            return 1;
+        }
+        long long skipped = q.SkipGuesses(keyspace_skip - history);
+        history += skipped;
+        position += skipped;
+        keyspace_end = keyspace_skip + (keyspace_limit >= 0 ? keyspace_limit : generate_n);
+        cout << "Keyspace [" << keyspace_skip << ", " << keyspace_end << "): skipped " << skipped << " guesses" << endl;
+    }
+    // 区间（--skip / --limit）或概率阈值枚举的猜测已经全部生成（区间终点之后的已截掉），以及已经哈希、比对和输出
+    bool range_done = false;
+    bool range_flushed = false;
+
+    CheckpointWriter checkpoints;
+    vector<char> checkpoint_state;
+    long long last_checkpoint = history;
 
     // bool local_not_empty = !q.priority.empty();
     // int global_not_empty = 0;
     // MPI_Allreduce(&local_not_empty, &global_not_empty, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
 
-    while (!q.priority.empty())
+    // 分布式队列的全局水位线：各进程队首概率的最大值，为 0 表示所有进程的队列都已为空
+    float watermark = distributed ? GlobalWatermark(q) : 0;
+
+    while (master_worker || (distributed ? watermark > 0 : !q.priority.empty()))
     {
-        q.PopNext();
+        // 主从调度：主进程调度到结束为止，工作进程每轮取得并生成一个任务，收到结束消息时 finished
+        bool finished = false;
+        if (range_done) {
+            // 区间内的猜测已经生成完毕，不再展开 PT，只做下面的结束判断
+        }
+        else if (master_worker) {
+            if (rank == 0) {
+                long long handed = q.MasterSchedule(generate_n);
+                cout << "Guesses handed out: " << handed << endl;
+                finished = true;
+            }
+            else {
+                finished = !q.WorkerFetch();
+            }
+        }
+        else if (threshold > 0) {
+            q.ThresholdGenerate(THRESHOLD_STEP_GUESSES);
+        }
+        else if (distributed) {
+            // 本地队列为空或队首概率低于水位线的进程本步不生成，但仍参与下面的汇总
+            q.DistributedStep(watermark * DIST_WATERMARK_RATIO, DIST_STEP_GUESSES);
+        }
+        else {
+            // openmp_persistent 一次连续处理多个 PT，直到生成至少 100000 个猜测；其余方法展开一个 PT
+            q.PopBatch(100000);
+        }
 
         // q.MPIPopNext(); // 并行化处理多个 PT
+
+        // 到达区间终点：只保留区间内的猜测
+        if (keyspace && !range_done && history + q.total_guesses >= keyspace_end) {
+            q.TruncateGuesses(keyspace_end - history);
+            range_done = true;
+        }
+        // 概率阈值枚举：所有进程的 PT 都生成完毕时结束
+        if (threshold > 0 && !range_done) {
+            int local_done = q.ThresholdDone(), all_done = 0;
+            MPI_Allreduce(&local_done, &all_done, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+            range_done = all_done;
+        }
         
-        // 收集所有进程的猜测总数
-        int local_guesses = q.guesses.size();
-        int global_guesses = 0;
-        MPI_Allreduce(&local_guesses, &global_guesses, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-        q.total_guesses = global_guesses;
-        
-        if (q.total_guesses - curr_num >= 100000)
+        // 所有进程的猜测总数：各进程的队列完全相同，MPI 方法按确定的划分分配猜测，
+        // 合计值每个进程都能在本地算出，不需要每个 PT 一次 MPI_Allreduce，各进程之间不再同步，
+        // 且每个进程得到的值相同，下面的输出、哈希和结束判断仍在同一轮发生
+        // 分布式队列下各进程的猜测数互不相同，每一步汇总一次（同时更新水位线）；概率阈值枚举同样每一步汇总一次
+        long long global_guesses = 0;
+        if (distributed) {
+            MPI_Allreduce(&q.total_guesses, &global_guesses, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+            watermark = GlobalWatermark(q);
+        }
+        else if (threshold > 0) {
+            MPI_Allreduce(&q.total_guesses, &global_guesses, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        }
+        else if (master_worker) {
+            // 主从调度：各工作进程只统计自己的猜测，何时结束由主进程决定
+            global_guesses = q.total_guesses;
+        }
+        else {
+            global_guesses = q.Partitioned() ? q.total_guesses : q.total_guesses * size;
+        }
+
+        if (finished || range_done || global_guesses - curr_num >= 100000)
         {
-            if (rank == 0) {
-                cout << "Guesses generated: " << history + q.total_guesses << endl;
+            if (rank == 0 && !master_worker) {
+                cout << "Guesses generated: " << history + global_guesses << endl;
             }
-            curr_num = q.total_guesses;
+            curr_num = global_guesses;
 
-            // 在此处更改实验生成的猜测上限
-            int generate_n = 10000000;
-            if (history + q.total_guesses > generate_n)
+            if (master_worker ? finished : ((keyspace || threshold > 0) ? range_flushed : history + global_guesses > generate_n))
             {
                 double mpi_time_guess_end = MPI_Wtime();
                 time_guess = mpi_time_guess_end - mpi_time_guess_start;
-                
-                if (rank == 0) {
-                    cout << "=== MPI Timing Results (Process " << rank << ") ===" << endl;
-                    cout << "Guess time: " << time_guess<< " seconds" << endl;
-                    cout << "Hash time: " << time_hash << "seconds"<<endl;
-                    cout << "Train time: " << time_train << " seconds" << endl;
-                    cout << "Cracked: " << cracked << endl;
+
+                // 汇总各进程剩余的命中记录，以及计时和计数
+                comm_thread.wait();
+                cout << checkpoint_report;
+                cout << GatherHits(TakeHits(hit_log, rank, replicated), rank, size, MPI_COMM_WORLD);
+                rankStats_t stats = {time_guess, time_hash, time_train,
+                                     (double)local_hashed + q.guesses.size(), (double)local_hashed,
+                                     (double)cracked, (double)hash_cracked};
+                ReportStats(stats, rank, size, replicated, targets.size());
+                if (curve_prefix != "") {
+                    curve.checkpoint(position, true);
+                    curve.write(size > 1 ? curve_prefix + "." + to_string(rank) : curve_prefix);
                 }
                 break;
             }
         }
 
-        if (curr_num > 1000000)
+        if (curr_num > 1000000 || (range_done && !range_flushed))
         {
             double start_hash = MPI_Wtime();
 
@@ -286,38 +1043,175 @@ int main(int argc, char *argv[])
             // 预分配字符串数组
             string inputs[batchSize];
 
-            // 处理完整批次
-            for (int batch = 0; batch < numFullBatches; ++batch) {
-                for (int i = 0; i < batchSize; ++i) {
-                    inputs[i] = q.guesses[batch * batchSize + i];
-                    if (test_set.find(inputs[i]) != test_set.end()) {
-                        cracked+=1;
+            // 不需要摘要时，直接把整批猜测交给输出流（写线程在后台写出，不阻塞哈希）
+            bool write_digests = writer.isOpen() && writer.withDigest();
+            if (writer.isOpen() && !write_digests) {
+                writer.write(q.guesses);
+            }
+
+            // 统计命中测试集的口令数（批量查询，访存相互重叠）
+            // 多个线程各比对一段猜测，命中记入各自的曲线缓冲区，没有共享写入
+            const int checkChunk = 1 << 16;
+            const int numChunks = (q.guesses.size() + checkChunk - 1) / checkChunk;
+            #pragma omp parallel num_threads(q.gen_threads) reduction(+:cracked)
+            {
+                int t_id = omp_get_thread_num();
+                vector<int> found;
+                #pragma omp for schedule(static)
+                for (int chunk = 0; chunk < numChunks; ++chunk) {
+                    int base = chunk * checkChunk;
+                    int n = min((size_t)checkChunk, q.guesses.size() - base);
+                    found.clear();
+                    cracked += test_set.count(q.guesses.data() + base, n, &found);
+                    for (int i : found) {
+                        const GuessSpan *span = q.FindSpan(base + i);
+                        curve.record(t_id, position + base + i, HIT_TESTSET,
+                                     span != NULL ? span->pattern : "", q.guesses[base + i]);
                     }
                 }
-                SIMDMD5Hash_4(inputs, state);
             }
 
-            // 处理剩余项（不足 4 个）
-            if (remainder > 0) {
-                for (int i = 0; i < remainder; ++i) {
-                    inputs[i] = q.guesses[numFullBatches * batchSize + i];
-                    if (test_set.find(inputs[i]) != test_set.end()) {
-                        cracked+=1;
+            // 其他方案：每批 4 个口令依次与所有盐值组合计算（口令只取一次，在缓存中与各盐值反复组合），
+            // 最后不足 4 个的一批用空串补齐，补齐的通道不参与比对
+            if (targets.size() > 0 && hasher.scheme != SCHEME_MD5) {
+                for (size_t base = 0; base < q.guesses.size(); base += batchSize) {
+                    int n = min((size_t)batchSize, q.guesses.size() - base);
+                    // 完整的一批直接使用 q.guesses 中的口令，不再逐个拷贝
+                    string *batch_inputs = q.guesses.data() + base;
+                    if (n < batchSize) {
+                        for (int i = 0; i < batchSize; ++i) {
+                            inputs[i] = i < n ? q.guesses[base + i] : "";
+                        }
+                        batch_inputs = inputs;
+                    }
+                    for (int salt = 0; salt < hasher.saltCount(); ++salt) {
+                        hasher.hash4(batch_inputs, salt, state);
+                        if (write_digests) {
+                            for (int i = 0; i < n; ++i) {
+                                writer.write(batch_inputs[i], state + i * 4);
+                            }
+                        }
+                        int hits = targets.probe4(state) & ((1 << n) - 1);
+                        for (int i = 0; hits != 0; ++i, hits >>= 1) {
+                            if (hits & 1) {
+                                ReportHit(hit_log, q, base + i, position, state + i * 4, rank, curve,
+                                          hasher.salted() ? hasher.salts[salt] : "");
+                                hash_cracked += 1;
+                            }
+                        }
                     }
                 }
-                // 剩余的用单个哈希函数处理
-                for (int i = 0; i < remainder; ++i) {
-                    bit32 singleState[4];
-                    MD5Hash(inputs[i], singleState);
+            }
+            else {
+                // 处理完整批次
+                for (int batch = 0; batch < numFullBatches; ++batch) {
+                    // q.guesses 是连续存放的 string 数组，直接把这一批的起始地址交给哈希函数，不再拷贝到 inputs
+                    string *batch_inputs = q.guesses.data() + batch * batchSize;
+
+                    // 早退破解：不输出摘要，只判断是否命中，命中的口令（极少）再单独计算摘要用于报告
+                    if (!early_targets.empty()) {
+                        int hits = SIMDMD5Crack_4(batch_inputs, early_targets.data(), early_targets.size());
+                        if (hits != 0) {
+                            hasher.hash4(batch_inputs, 0, state);
+                        }
+                        for (int i = 0; hits != 0; ++i, hits >>= 1) {
+                            if (hits & 1) {
+                                ReportHit(hit_log, q, batch * batchSize + i, position, state + i * 4, rank, curve);
+                                hash_cracked += 1;
+                            }
+                        }
+                        continue;
+                    }
+
+                    // SIMDMD5Hash_4 按第一个口令的块数处理所有通道，块数不同时（口令长度跨过 55 字节）结果不正确，
+                    // 输出的摘要和与目标的比对都会出错；这里统一使用按通道处理块数的 SIMDMD5HashFrom_4（hasher 的 md5 方案）
+                    hasher.hash4(batch_inputs, 0, state);
+                    if (write_digests) {
+                        for (int i = 0; i < batchSize; ++i) {
+                            writer.write(batch_inputs[i], state + i * 4);
+                        }
+                    }
+
+                    // 与目标哈希比对，hits 的第 i 位表示该批第 i 个口令命中
+                    int hits = targets.probe4(state);
+                    for (int i = 0; hits != 0; ++i, hits >>= 1) {
+                        if (hits & 1) {
+                            ReportHit(hit_log, q, batch * batchSize + i, position, state + i * 4, rank, curve);
+                            hash_cracked += 1;
+                        }
+                    }
+                }
+
+                // 处理剩余项（不足 4 个）：与其他方案一样用空串补齐为一批，补齐的通道不输出也不参与比对
+                if (remainder > 0) {
+                    for (int i = 0; i < batchSize; ++i) {
+                        inputs[i] = i < remainder ? q.guesses[numFullBatches * batchSize + i] : "";
+                    }
+                    hasher.hash4(inputs, 0, state);
+                    if (write_digests) {
+                        for (int i = 0; i < remainder; ++i) {
+                            writer.write(inputs[i], state + i * 4);
+                        }
+                    }
+                    int hits = targets.probe4(state) & ((1 << remainder) - 1);
+                    for (int i = 0; hits != 0; ++i, hits >>= 1) {
+                        if (hits & 1) {
+                            ReportHit(hit_log, q, numFullBatches * batchSize + i, position, state + i * 4, rank, curve);
+                            hash_cracked += 1;
+                        }
+                    }
                 }
             }
 
             double end_hash = MPI_Wtime();
             time_hash += end_hash - start_hash;
 
+            local_hashed += q.guesses.size();
+            position += q.guesses.size();
             history += curr_num;
             curr_num = 0;
-            q.guesses.clear();
+            q.ClearGuesses();
+            range_flushed = range_done;
+
+            // 检查点：合并各线程记录的命中，更新破解曲线（横轴为本进程的猜测序号，与命中报告一致）
+            curve.checkpoint(position);
+
+            // 各进程在同一轮到达检查点时，把命中记录和破解数汇总到 0 号进程；
+            // 主从调度下各工作进程的检查点互不同步，只在结束时汇总
+            // 汇总由通信线程在后台完成，结果在下一个检查点（或结束时）输出，本进程随即继续生成
+            if (!master_worker) {
+                comm_thread.wait();
+                cout << checkpoint_report;
+                checkpoint_report.clear();
+
+                string hits = TakeHits(hit_log, rank, replicated);
+                int local_cracked = (replicated && rank != 0) ? 0 : cracked;
+                comm_thread.post([hits, local_cracked, rank, size, &checkpoint_report](MPI_Comm comm) {
+                    string all = GatherHits(hits, rank, size, comm);
+                    int global_cracked = 0;
+                    MPI_Reduce(&local_cracked, &global_cracked, 1, MPI_INT, MPI_SUM, 0, comm);
+                    if (rank == 0) {
+                        checkpoint_report = all + "Cracked so far: " + to_string(global_cracked) + "\n";
+                    }
+                });
+            }
+
+            // 写检查点：各进程在同一个检查点（history 相同）编码自己的队列，由后台线程写出
+            if (checkpoint_prefix != "" && history - last_checkpoint >= checkpoint_interval) {
+                checkpointHeader_t header = {};
+                header.rank = rank;
+                header.size = size;
+                header.backend = checkpoint_backend;
+                header.distributed = distributed;
+                header.history = history;
+                header.cracked = cracked;
+                header.hash_cracked = hash_cracked;
+                header.hashed = local_hashed;
+                header.position = position;
+                q.SaveState(checkpoint_state);
+                checkpoints.submit(CheckpointPath(checkpoint_prefix, rank, size), header, checkpoint_state);
+                last_checkpoint = history;
+            }
 
         }
 
@@ -325,6 +1219,22 @@ int main(int argc, char *argv[])
         // MPI_Allreduce(&local_not_empty, &global_not_empty, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
     }
 
+    // 输出写到一半失败（如磁盘已满）时，输出文件不完整，报告错误并以非 0 状态退出
+    bool output_ok = writer.close();
+    if (!output_ok) {
+        cerr << "Error writing output " << output_path << " (rank " << rank << "): "
+             << strerror(writer.writeError()) << endl;
+    }
+    if (checkpoint_prefix != "") {
+        checkpoints.wait();
+        if (rank == 0) {
+            cout << "Checkpoints written: " << checkpoints.written() << endl;
+        }
+    }
+    comm_thread.stop();
+    q.comm_thread = NULL;
+    deleteThreadPool();
+    q.m.ReleaseShared();
     MPI_Finalize();
-    return 0;
+    return output_ok ? 0 : 1;
 }
@@ -1,4 +1,5 @@
 #include "md5.h"
+#include "arena.h"
 #include <iomanip>
 #include <assert.h>
 #include <chrono>
@@ -105,13 +106,14 @@ static int CalculatePadded(int length) {
  * @param[out] n_byte 用于给调用者传递额外的返回值(1)，即各个口令最终 Byte 数组的长度
  * @param guess_num 并行同时处理的口令个数
  * @param[out] max_byte 用于给调用者传递额外的返回值(2)，即所有口令最终 Byte 数组长度中的最大值
- * @return Byte 消息数组
+ * @return Byte 消息数组，分配在当前线程的暂存区 ThreadArena() 中，调用者用完后 rewind 到调用前的 mark 即可释放
  */
 Byte *SIMDStringProcess(string *inputs, int *n_byte, int guess_num, int &max_byte)
 {
 	// maxPaddedLength：最大 Byte 数组长度
 	int maxPaddedLength = 0;
-	int *paddedLengths = new int[guess_num];
+	Arena &arena = ThreadArena();
+	int *paddedLengths = (int *)arena.alloc(guess_num * sizeof(int), alignof(int));
 
 	// 计算每个输入消息的 Byte 数组长度并找到最大值
 	for (int i = 0; i < guess_num; i++) {
@@ -124,8 +126,9 @@ Byte *SIMDStringProcess(string *inputs, int *n_byte, int guess_num, int &max_byt
 	// paddedData：SIMD 优化所需的首地址对齐的整合内存块
 	// ALIGNMENT： NEON SIMD 向量指令处理数据的对齐要求是 *16 字节对齐*
 	// 已经求得所有消息中最大的 paddingByte 数组长度，根据这个长度进行内存对齐即可
+	// 从线程暂存区中分配（只移动偏移量），不再每批调用一次 aligned_alloc / free
 	constexpr int ALIGNMENT = 16;
-	Byte *paddedData = (Byte *)aligned_alloc(ALIGNMENT, maxPaddedLength * guess_num);
+	Byte *paddedData = (Byte *)arena.alloc(maxPaddedLength * guess_num, ALIGNMENT);
 
 	// 依次对每个原始消息进行 padding
 	for (int i = 0; i < guess_num; i++) {
@@ -161,8 +164,6 @@ Byte *SIMDStringProcess(string *inputs, int *n_byte, int guess_num, int &max_byt
 	memcpy(n_byte, paddedLengths, guess_num * sizeof(int));
 	max_byte = maxPaddedLength;
 
-	// 善后操作
-	delete[] paddedLengths;
 	return paddedData;
 }
 
@@ -323,13 +324,15 @@ void SIMDMD5Hash_4(string *inputs, bit32 *state)
 	const int PARA_NUM = 4;
 
 	// messageLenths：记录各个消息的 Byte 数组长度
-	int *messageLengths = new int[PARA_NUM];
+	int messageLengths[PARA_NUM];
 
 	// maxByte：记录最大Byte数组长度
 	int maxByte = 0;
 
 	// 对所有消息进行初始化，获得整合 *16 字节对齐* 内存块
 	// 同时获取各个消息的 Byte 数组长度和最大 Byte 数组长度
+	// 填充后的消息块分配在线程暂存区中，函数结束时 rewind 一次性释放
+	size_t arenaMark = ThreadArena().mark();
 	Byte *paddedData = SIMDStringProcess(inputs, messageLengths, PARA_NUM, maxByte);
 
 	// 将各消息分为 n_blocks 个 512bit 的部分
@@ -470,8 +473,7 @@ void SIMDMD5Hash_4(string *inputs, bit32 *state)
 	}
 
 	// 回收内存
-	delete[] paddedData;
-	delete[] messageLengths;
+	ThreadArena().rewind(arenaMark);
 }
 
 /**
@@ -484,8 +486,10 @@ void SIMDMD5Hash_4(string *inputs, bit32 *state)
 void SIMDMD5Hash_2(string *inputs, bit32 *state)
 {
 	const int PARA_NUM = 2;
-	int *messageLengths = new int[PARA_NUM];
+	int messageLengths[PARA_NUM];
 	int maxByte = 0;
+	// 填充后的消息块分配在线程暂存区中，函数结束时 rewind 一次性释放
+	size_t arenaMark = ThreadArena().mark();
 	Byte *paddedData = SIMDStringProcess(inputs, messageLengths, PARA_NUM, maxByte);
 	
 	int n_blocks = messageLengths[0] / 64;
@@ -603,8 +607,7 @@ void SIMDMD5Hash_2(string *inputs, bit32 *state)
 				   ((value & 0xff000000) >> 24); 
 	}
 
-	delete[] paddedData;
-	delete[] messageLengths;
+	ThreadArena().rewind(arenaMark);
 }
 
 /**
@@ -617,8 +620,10 @@ void SIMDMD5Hash_2(string *inputs, bit32 *state)
 void SIMDMD5Hash_8basic(string *inputs, bit32 *state)
 {
 	const int PARA_NUM = 8;				// 8
-	int *messageLengths = new int[PARA_NUM];
+	int messageLengths[PARA_NUM];
 	int maxByte = 0;
+	// 填充后的消息块分配在线程暂存区中，函数结束时 rewind 一次性释放
+	size_t arenaMark = ThreadArena().mark();
 	Byte *paddedData = SIMDStringProcess(inputs, messageLengths, PARA_NUM, maxByte);
 	
 	int n_blocks = messageLengths[0] / 64;
@@ -834,8 +839,7 @@ void SIMDMD5Hash_8basic(string *inputs, bit32 *state)
 				   ((value & 0xff000000) >> 24); 
 	}
 
-	delete[] paddedData;
-	delete[] messageLengths;
+	ThreadArena().rewind(arenaMark);
 }
 
 /**
@@ -848,8 +852,10 @@ void SIMDMD5Hash_8basic(string *inputs, bit32 *state)
 void SIMDMD5Hash_8advanced(string *inputs, bit32 *state)
 {
 	const int PARA_NUM = 8;				// 8
-	int *messageLengths = new int[PARA_NUM];
+	int messageLengths[PARA_NUM];
 	int maxByte = 0;
+	// 填充后的消息块分配在线程暂存区中，函数结束时 rewind 一次性释放
+	size_t arenaMark = ThreadArena().mark();
 	Byte *paddedData = SIMDStringProcess(inputs, messageLengths, PARA_NUM, maxByte);
 	
 	int n_blocks = messageLengths[0] / 64;
@@ -1006,6 +1012,433 @@ void SIMDMD5Hash_8advanced(string *inputs, bit32 *state)
 				((value & 0xff000000) >> 24); 
 	}
 
-	delete[] paddedData;
-	delete[] messageLengths;
-}
\ No newline at end of file
+	ThreadArena().rewind(arenaMark);
+}
+/**
+ * ByteSwap: 大小端转换（MD5 结果输出时的逆操作）
+ */
+static inline bit32 ByteSwap(bit32 value)
+{
+	return ((value & 0xff) << 24) | ((value & 0xff00) << 8) |
+		   ((value & 0xff0000) >> 8) | ((value & 0xff000000) >> 24);
+}
+
+/**
+ * MD5ReverseTarget: 由目标摘要反推 MD5 最后几步之前的中间状态，用于早退比对
+ * 先减去初始状态得到第 64 步之后的 a, b, c, d，再按 II_REVERSE 依次反推第 64~57 步，
+ * 这几步的消息字（M9, M2, M11, M4, M13, M6, M15, M8）在口令足够短时都只含填充的 0
+ * @param digest 目标摘要（与 MD5Hash 输出的 state 格式相同）
+ * @param[out] target 早退比对的目标
+ */
+void MD5ReverseTarget(const bit32 *digest, md5Target_t &target)
+{
+	memcpy(target.digest, digest, sizeof(target.digest));
+
+	bit32 a = ByteSwap(digest[0]) - 0x67452301;
+	bit32 b = ByteSwap(digest[1]) - 0xefcdab89;
+	bit32 c = ByteSwap(digest[2]) - 0x98badcfe;
+	bit32 d = ByteSwap(digest[3]) - 0x10325476;
+
+	// 不反推：第 61 步之后 a 不再改变
+	target.early[0] = a;
+
+	// 反推第 64 步，得到第 63 步之后的状态，其中 b 由第 60 步写入
+	II_REVERSE(b, c, d, a, 0, s44, 0xeb86d391);
+	target.early[1] = b;
+
+	// 继续反推第 63~57 步，得到第 56 步之后的状态，其中 a 由第 53 步写入
+	II_REVERSE(c, d, a, b, 0, s43, 0x2ad7d2bb);
+	II_REVERSE(d, a, b, c, 0, s42, 0xbd3af235);
+	II_REVERSE(a, b, c, d, 0, s41, 0xf7537e82);
+	II_REVERSE(b, c, d, a, 0, s44, 0x4e0811a1);
+	II_REVERSE(c, d, a, b, 0, s43, 0xa3014314);
+	II_REVERSE(d, a, b, c, 0, s42, 0xfe2ce6e0);
+	II_REVERSE(a, b, c, d, 0, s41, 0x6fa87e4f);
+	target.early[2] = a;
+}
+
+/**
+ * EarlyMatch: 将四个通道的寄存器值与所有目标的早退值比较，返回可能命中的通道掩码
+ * @param reg 四个通道的寄存器值
+ * @param level 早退值的下标，见 md5Target_t::early
+ */
+static inline int EarlyMatch(uint32x4_t reg, const md5Target_t *targets, int n_targets, int level)
+{
+	uint32x4_t eq = vdupq_n_u32(0);
+	for (int t = 0; t < n_targets; t++) {
+		eq = vorrq_u32(eq, vceqq_u32(reg, vdupq_n_u32(targets[t].early[level])));
+	}
+	return (vgetq_lane_u32(eq, 0) & 1) | (vgetq_lane_u32(eq, 1) & 2) |
+		   (vgetq_lane_u32(eq, 2) & 4) | (vgetq_lane_u32(eq, 3) & 8);
+}
+
+/**
+ * ConfirmMatch: 对早退比对可能命中的通道计算完整的 MD5，与目标摘要精确比较
+ *				 用 SIMDMD5HashFrom_4（空前缀）一次算出四个通道：各通道的块数可以不同，
+ *				 也不经过 MD5Hash 的填充（其长度对 64 取余为 57~63 时会出错）
+ * @param inputs 输入
+ * @param candidates 可能命中的通道掩码
+ * @return 确认命中的通道掩码
+ */
+static int ConfirmMatch(string *inputs, int candidates, const md5Target_t *targets, int n_targets)
+{
+	static const md5Midstate_t empty = [] {
+		md5Midstate_t mid;
+		MD5Midstate("", mid);
+		return mid;
+	}();
+
+	int hit_mask = 0;
+	bit32 state[4 * 4];
+	SIMDMD5HashFrom_4(empty, inputs, state);
+	for (int lane = 0; lane < 4; lane++) {
+		if (!(candidates & (1 << lane))) {
+			continue;
+		}
+		for (int t = 0; t < n_targets; t++) {
+			if (memcmp(state + lane * 4, targets[t].digest, sizeof(targets[t].digest)) == 0) {
+				hit_mask |= 1 << lane;
+				break;
+			}
+		}
+	}
+	return hit_mask;
+}
+
+/**
+ * SIMDMD5Crack_4: 早退破解版本的四路并行 MD5
+ *				   只判断口令是否命中少量目标摘要，不输出摘要本身
+ *				   单块消息只计算到比对所需的那一步（见 md5Target_t），可能命中时再用完整的 MD5 确认；
+ *				   多块消息（口令长度 > 55）无法反推，计算完整的 MD5 后比较
+ * @param inputs 输入（4 个口令）
+ * @param targets 早退比对的目标（由 MD5ReverseTarget 计算）
+ * @param n_targets 目标数（目标较多时逐个比较的开销会抵消早退的收益，应改用 SIMDMD5Hash_4 + 查表）
+ * @return 命中的通道掩码，第 i 位为 1 表示 inputs[i] 命中
+ */
+int SIMDMD5Crack_4(string *inputs, const md5Target_t *targets, int n_targets)
+{
+	const int PARA_NUM = 4;
+
+	// 最大口令长度决定了可以反推的步数
+	int maxLength = 0;
+	for (int i = 0; i < PARA_NUM; i++) {
+		maxLength = max(maxLength, (int)inputs[i].length());
+	}
+
+	// 多块消息：SIMDMD5Hash_4 按第一个口令的块数处理所有通道，块数不一致时结果不正确，这里按各通道自己的块数计算完整的 MD5
+	if (maxLength > 55) {
+		return ConfirmMatch(inputs, (1 << PARA_NUM) - 1, targets, n_targets);
+	}
+
+	// 单块消息：直接在栈上完成填充（0x80 + 0 + 64 位长度），不需要 SIMDStringProcess 分配内存
+	alignas(16) Byte block[PARA_NUM][64];
+	memset(block, 0, sizeof(block));
+	for (int i = 0; i < PARA_NUM; i++) {
+		int length = inputs[i].length();
+		memcpy(block[i], inputs[i].c_str(), length);
+		block[i][length] = 0x80;
+		bit32 bitLength = length * 8;
+		memcpy(block[i] + 56, &bitLength, sizeof(bitLength));
+	}
+
+	// 按小端读入消息字，每个 M 向量的第 i 个通道对应第 i 个口令
+	uint32x4_t M[16];
+	for (int i1 = 0; i1 < 16; ++i1) {
+		uint32_t temp_vec[4];
+		for (int i2 = 0; i2 < PARA_NUM; ++i2) {
+			memcpy(&temp_vec[i2], block[i2] + 4 * i1, sizeof(uint32_t));
+		}
+		M[i1] = vld1q_u32(temp_vec);
+	}
+
+	uint32x4_t a = vdupq_n_u32(0x67452301);
+	uint32x4_t b = vdupq_n_u32(0xefcdab89);
+	uint32x4_t c = vdupq_n_u32(0x98badcfe);
+	uint32x4_t d = vdupq_n_u32(0x10325476);
+
+	/* Round 1 */
+	FF_SIMD(a, b, c, d, M[0], s11, 0xd76aa478);
+	FF_SIMD(d, a, b, c, M[1], s12, 0xe8c7b756);
+	FF_SIMD(c, d, a, b, M[2], s13, 0x242070db);
+	FF_SIMD(b, c, d, a, M[3], s14, 0xc1bdceee);
+	FF_SIMD(a, b, c, d, M[4], s11, 0xf57c0faf);
+	FF_SIMD(d, a, b, c, M[5], s12, 0x4787c62a);
+	FF_SIMD(c, d, a, b, M[6], s13, 0xa8304613);
+	FF_SIMD(b, c, d, a, M[7], s14, 0xfd469501);
+	FF_SIMD(a, b, c, d, M[8], s11, 0x698098d8);
+	FF_SIMD(d, a, b, c, M[9], s12, 0x8b44f7af);
+	FF_SIMD(c, d, a, b, M[10], s13, 0xffff5bb1);
+	FF_SIMD(b, c, d, a, M[11], s14, 0x895cd7be);
+	FF_SIMD(a, b, c, d, M[12], s11, 0x6b901122);
+	FF_SIMD(d, a, b, c, M[13], s12, 0xfd987193);
+	FF_SIMD(c, d, a, b, M[14], s13, 0xa679438e);
+	FF_SIMD(b, c, d, a, M[15], s14, 0x49b40821);
+
+	/* Round 2 */
+	GG_SIMD(a, b, c, d, M[1], s21, 0xf61e2562);
+	GG_SIMD(d, a, b, c, M[6], s22, 0xc040b340);
+	GG_SIMD(c, d, a, b, M[11], s23, 0x265e5a51);
+	GG_SIMD(b, c, d, a, M[0], s24, 0xe9b6c7aa);
+	GG_SIMD(a, b, c, d, M[5], s21, 0xd62f105d);
+	GG_SIMD(d, a, b, c, M[10], s22, 0x2441453);
+	GG_SIMD(c, d, a, b, M[15], s23, 0xd8a1e681);
+	GG_SIMD(b, c, d, a, M[4], s24, 0xe7d3fbc8);
+	GG_SIMD(a, b, c, d, M[9], s21, 0x21e1cde6);
+	GG_SIMD(d, a, b, c, M[14], s22, 0xc33707d6);
+	GG_SIMD(c, d, a, b, M[3], s23, 0xf4d50d87);
+	GG_SIMD(b, c, d, a, M[8], s24, 0x455a14ed);
+	GG_SIMD(a, b, c, d, M[13], s21, 0xa9e3e905);
+	GG_SIMD(d, a, b, c, M[2], s22, 0xfcefa3f8);
+	GG_SIMD(c, d, a, b, M[7], s23, 0x676f02d9);
+	GG_SIMD(b, c, d, a, M[12], s24, 0x8d2a4c8a);
+
+	/* Round 3 */
+	HH_SIMD(a, b, c, d, M[5], s31, 0xfffa3942);
+	HH_SIMD(d, a, b, c, M[8], s32, 0x8771f681);
+	HH_SIMD(c, d, a, b, M[11], s33, 0x6d9d6122);
+	HH_SIMD(b, c, d, a, M[14], s34, 0xfde5380c);
+	HH_SIMD(a, b, c, d, M[1], s31, 0xa4beea44);
+	HH_SIMD(d, a, b, c, M[4], s32, 0x4bdecfa9);
+	HH_SIMD(c, d, a, b, M[7], s33, 0xf6bb4b60);
+	HH_SIMD(b, c, d, a, M[10], s34, 0xbebfbc70);
+	HH_SIMD(a, b, c, d, M[13], s31, 0x289b7ec6);
+	HH_SIMD(d, a, b, c, M[0], s32, 0xeaa127fa);
+	HH_SIMD(c, d, a, b, M[3], s33, 0xd4ef3085);
+	HH_SIMD(b, c, d, a, M[6], s34, 0x4881d05);
+	HH_SIMD(a, b, c, d, M[9], s31, 0xd9d4d039);
+	HH_SIMD(d, a, b, c, M[12], s32, 0xe6db99e5);
+	HH_SIMD(c, d, a, b, M[15], s33, 0x1fa27cf8);
+	HH_SIMD(b, c, d, a, M[2], s34, 0xc4ac5665);
+
+	/* Round 4（第 49~53 步）*/
+	II_SIMD(a, b, c, d, M[0], s41, 0xf4292244);
+	II_SIMD(d, a, b, c, M[7], s42, 0x432aff97);
+	II_SIMD(c, d, a, b, M[14], s43, 0xab9423a7);
+	II_SIMD(b, c, d, a, M[5], s44, 0xfc93a039);
+	II_SIMD(a, b, c, d, M[12], s41, 0x655b59c3);
+
+	// 口令长度 <= 7：第 53 步之后即可比对 a
+	int candidates;
+	if (maxLength <= 7) {
+		candidates = EarlyMatch(a, targets, n_targets, 2);
+		return candidates ? ConfirmMatch(inputs, candidates, targets, n_targets) : 0;
+	}
+
+	/* Round 4（第 54~60 步）*/
+	II_SIMD(d, a, b, c, M[3], s42, 0x8f0ccc92);
+	II_SIMD(c, d, a, b, M[10], s43, 0xffeff47d);
+	II_SIMD(b, c, d, a, M[1], s44, 0x85845dd1);
+	II_SIMD(a, b, c, d, M[8], s41, 0x6fa87e4f);
+	II_SIMD(d, a, b, c, M[15], s42, 0xfe2ce6e0);
+	II_SIMD(c, d, a, b, M[6], s43, 0xa3014314);
+	II_SIMD(b, c, d, a, M[13], s44, 0x4e0811a1);
+
+	// 口令长度 <= 35：第 60 步之后即可比对 b
+	if (maxLength <= 35) {
+		candidates = EarlyMatch(b, targets, n_targets, 1);
+		return candidates ? ConfirmMatch(inputs, candidates, targets, n_targets) : 0;
+	}
+
+	/* Round 4（第 61 步）*/
+	II_SIMD(a, b, c, d, M[4], s41, 0xf7537e82);
+
+	// 其余单块消息：第 61 步之后比对 a
+	candidates = EarlyMatch(a, targets, n_targets, 0);
+	return candidates ? ConfirmMatch(inputs, candidates, targets, n_targets) : 0;
+}
+
+/**
+ * SIMDMD5Transform_4: 四路并行地对一个 512bit 块执行 64 步运算，并加回到状态上
+ * @param M 块中的 16 个消息字，每个向量的第 i 个通道对应第 i 个消息
+ * @param[in,out] state_a, state_b, state_c, state_d 四个状态寄存器
+ */
+static inline void SIMDMD5Transform_4(const uint32x4_t *M, uint32x4_t &state_a, uint32x4_t &state_b,
+									  uint32x4_t &state_c, uint32x4_t &state_d)
+{
+	uint32x4_t a = state_a, b = state_b, c = state_c, d = state_d;
+
+	/* Round 1 */
+	FF_SIMD(a, b, c, d, M[0], s11, 0xd76aa478);
+	FF_SIMD(d, a, b, c, M[1], s12, 0xe8c7b756);
+	FF_SIMD(c, d, a, b, M[2], s13, 0x242070db);
+	FF_SIMD(b, c, d, a, M[3], s14, 0xc1bdceee);
+	FF_SIMD(a, b, c, d, M[4], s11, 0xf57c0faf);
+	FF_SIMD(d, a, b, c, M[5], s12, 0x4787c62a);
+	FF_SIMD(c, d, a, b, M[6], s13, 0xa8304613);
+	FF_SIMD(b, c, d, a, M[7], s14, 0xfd469501);
+	FF_SIMD(a, b, c, d, M[8], s11, 0x698098d8);
+	FF_SIMD(d, a, b, c, M[9], s12, 0x8b44f7af);
+	FF_SIMD(c, d, a, b, M[10], s13, 0xffff5bb1);
+	FF_SIMD(b, c, d, a, M[11], s14, 0x895cd7be);
+	FF_SIMD(a, b, c, d, M[12], s11, 0x6b901122);
+	FF_SIMD(d, a, b, c, M[13], s12, 0xfd987193);
+	FF_SIMD(c, d, a, b, M[14], s13, 0xa679438e);
+	FF_SIMD(b, c, d, a, M[15], s14, 0x49b40821);
+
+	/* Round 2 */
+	GG_SIMD(a, b, c, d, M[1], s21, 0xf61e2562);
+	GG_SIMD(d, a, b, c, M[6], s22, 0xc040b340);
+	GG_SIMD(c, d, a, b, M[11], s23, 0x265e5a51);
+	GG_SIMD(b, c, d, a, M[0], s24, 0xe9b6c7aa);
+	GG_SIMD(a, b, c, d, M[5], s21, 0xd62f105d);
+	GG_SIMD(d, a, b, c, M[10], s22, 0x2441453);
+	GG_SIMD(c, d, a, b, M[15], s23, 0xd8a1e681);
+	GG_SIMD(b, c, d, a, M[4], s24, 0xe7d3fbc8);
+	GG_SIMD(a, b, c, d, M[9], s21, 0x21e1cde6);
+	GG_SIMD(d, a, b, c, M[14], s22, 0xc33707d6);
+	GG_SIMD(c, d, a, b, M[3], s23, 0xf4d50d87);
+	GG_SIMD(b, c, d, a, M[8], s24, 0x455a14ed);
+	GG_SIMD(a, b, c, d, M[13], s21, 0xa9e3e905);
+	GG_SIMD(d, a, b, c, M[2], s22, 0xfcefa3f8);
+	GG_SIMD(c, d, a, b, M[7], s23, 0x676f02d9);
+	GG_SIMD(b, c, d, a, M[12], s24, 0x8d2a4c8a);
+
+	/* Round 3 */
+	HH_SIMD(a, b, c, d, M[5], s31, 0xfffa3942);
+	HH_SIMD(d, a, b, c, M[8], s32, 0x8771f681);
+	HH_SIMD(c, d, a, b, M[11], s33, 0x6d9d6122);
+	HH_SIMD(b, c, d, a, M[14], s34, 0xfde5380c);
+	HH_SIMD(a, b, c, d, M[1], s31, 0xa4beea44);
+	HH_SIMD(d, a, b, c, M[4], s32, 0x4bdecfa9);
+	HH_SIMD(c, d, a, b, M[7], s33, 0xf6bb4b60);
+	HH_SIMD(b, c, d, a, M[10], s34, 0xbebfbc70);
+	HH_SIMD(a, b, c, d, M[13], s31, 0x289b7ec6);
+	HH_SIMD(d, a, b, c, M[0], s32, 0xeaa127fa);
+	HH_SIMD(c, d, a, b, M[3], s33, 0xd4ef3085);
+	HH_SIMD(b, c, d, a, M[6], s34, 0x4881d05);
+	HH_SIMD(a, b, c, d, M[9], s31, 0xd9d4d039);
+	HH_SIMD(d, a, b, c, M[12], s32, 0xe6db99e5);
+	HH_SIMD(c, d, a, b, M[15], s33, 0x1fa27cf8);
+	HH_SIMD(b, c, d, a, M[2], s34, 0xc4ac5665);
+
+	/* Round 4 */
+	II_SIMD(a, b, c, d, M[0], s41, 0xf4292244);
+	II_SIMD(d, a, b, c, M[7], s42, 0x432aff97);
+	II_SIMD(c, d, a, b, M[14], s43, 0xab9423a7);
+	II_SIMD(b, c, d, a, M[5], s44, 0xfc93a039);
+	II_SIMD(a, b, c, d, M[12], s41, 0x655b59c3);
+	II_SIMD(d, a, b, c, M[3], s42, 0x8f0ccc92);
+	II_SIMD(c, d, a, b, M[10], s43, 0xffeff47d);
+	II_SIMD(b, c, d, a, M[1], s44, 0x85845dd1);
+	II_SIMD(a, b, c, d, M[8], s41, 0x6fa87e4f);
+	II_SIMD(d, a, b, c, M[15], s42, 0xfe2ce6e0);
+	II_SIMD(c, d, a, b, M[6], s43, 0xa3014314);
+	II_SIMD(b, c, d, a, M[13], s44, 0x4e0811a1);
+	II_SIMD(a, b, c, d, M[4], s41, 0xf7537e82);
+	II_SIMD(d, a, b, c, M[11], s42, 0xbd3af235);
+	II_SIMD(c, d, a, b, M[2], s43, 0x2ad7d2bb);
+	II_SIMD(b, c, d, a, M[9], s44, 0xeb86d391);
+
+	state_a = vaddq_u32(state_a, a);
+	state_b = vaddq_u32(state_b, b);
+	state_c = vaddq_u32(state_c, c);
+	state_d = vaddq_u32(state_d, d);
+}
+
+/**
+ * MD5Midstate: 计算前缀的中间状态
+ * 前缀中完整的 64 字节块在这里处理（四个通道放同一个块，取第一个通道），剩余部分留给每个消息拼接
+ * @param prefix 前缀（如盐值）
+ * @param[out] mid 中间状态
+ */
+void MD5Midstate(const string &prefix, md5Midstate_t &mid)
+{
+	uint32x4_t a = vdupq_n_u32(0x67452301);
+	uint32x4_t b = vdupq_n_u32(0xefcdab89);
+	uint32x4_t c = vdupq_n_u32(0x98badcfe);
+	uint32x4_t d = vdupq_n_u32(0x10325476);
+
+	size_t full = prefix.length() / 64 * 64;
+	for (size_t offset = 0; offset < full; offset += 64) {
+		uint32x4_t M[16];
+		for (int i1 = 0; i1 < 16; ++i1) {
+			uint32_t word;
+			memcpy(&word, prefix.data() + offset + 4 * i1, sizeof(word));
+			M[i1] = vdupq_n_u32(word);
+		}
+		SIMDMD5Transform_4(M, a, b, c, d);
+	}
+
+	mid.state[0] = vgetq_lane_u32(a, 0);
+	mid.state[1] = vgetq_lane_u32(b, 0);
+	mid.state[2] = vgetq_lane_u32(c, 0);
+	mid.state[3] = vgetq_lane_u32(d, 0);
+	mid.length = full;
+	mid.tail = prefix.substr(full);
+}
+
+/**
+ * SIMDMD5HashFrom_4: 从中间状态出发，四路并行地计算 md5(前缀 + inputs[i])
+ *					  与 SIMDMD5Hash_4 不同，各通道按自己的块数处理：已经处理完的通道不再更新状态
+ * @param mid 前缀的中间状态（由 MD5Midstate 计算，前缀为空时即普通的 MD5）
+ * @param inputs 输入（4 个消息，不含前缀）
+ * @param[out] state MD5 结果，格式与 SIMDMD5Hash_4 相同
+ */
+void SIMDMD5HashFrom_4(const md5Midstate_t &mid, string *inputs, bit32 *state)
+{
+	const int PARA_NUM = 4;
+	const int tailLength = mid.tail.length();
+
+	// 各通道的消息长度（前缀剩余部分 + 输入）与块数，填充后至少多出 9 个字节（0x80 + 64 位长度）
+	int blocks[PARA_NUM];
+	int maxBlocks = 0;
+	for (int i = 0; i < PARA_NUM; i++) {
+		blocks[i] = (tailLength + inputs[i].length() + 8) / 64 + 1;
+		maxBlocks = max(maxBlocks, blocks[i]);
+	}
+
+	// 各通道的消息首尾相接，步长为 maxBlocks * 64
+	const int stride = maxBlocks * 64;
+	size_t arenaMark = ThreadArena().mark();
+	Byte *paddedData = (Byte *)ThreadArena().alloc(stride * PARA_NUM, 16);
+	memset(paddedData, 0, stride * PARA_NUM);
+	for (int i = 0; i < PARA_NUM; i++) {
+		Byte *message = paddedData + i * stride;
+		int length = tailLength + inputs[i].length();
+		memcpy(message, mid.tail.data(), tailLength);
+		memcpy(message + tailLength, inputs[i].data(), inputs[i].length());
+		message[length] = 0x80;
+		uint64_t bitLength = ((uint64_t)mid.length + length) * 8;
+		memcpy(message + blocks[i] * 64 - 8, &bitLength, sizeof(bitLength));
+	}
+
+	uint32x4_t state_a = vdupq_n_u32(mid.state[0]);
+	uint32x4_t state_b = vdupq_n_u32(mid.state[1]);
+	uint32x4_t state_c = vdupq_n_u32(mid.state[2]);
+	uint32x4_t state_d = vdupq_n_u32(mid.state[3]);
+	uint32x4_t n_blocks = {(uint32_t)blocks[0], (uint32_t)blocks[1], (uint32_t)blocks[2], (uint32_t)blocks[3]};
+
+	for (int i = 0; i < maxBlocks; i += 1) {
+		uint32x4_t M[16];
+		for (int i1 = 0; i1 < 16; ++i1) {
+			uint32_t temp_vec[4];
+			for (int i2 = 0; i2 < PARA_NUM; ++i2) {
+				memcpy(&temp_vec[i2], paddedData + i2 * stride + i * 64 + 4 * i1, sizeof(uint32_t));
+			}
+			M[i1] = vld1q_u32(temp_vec);
+		}
+
+		uint32x4_t a = state_a, b = state_b, c = state_c, d = state_d;
+		SIMDMD5Transform_4(M, a, b, c, d);
+
+		// 只有块数大于 i 的通道接受这一块的结果
+		uint32x4_t active = vcgtq_u32(n_blocks, vdupq_n_u32(i));
+		state_a = vbslq_u32(active, a, state_a);
+		state_b = vbslq_u32(active, b, state_b);
+		state_c = vbslq_u32(active, c, state_c);
+		state_d = vbslq_u32(active, d, state_d);
+	}
+	ThreadArena().rewind(arenaMark);
+
+	// 转置并转换为大端格式，与 SIMDMD5Hash_4 的输出一致
+	bit32 lanes[4][PARA_NUM];
+	vst1q_u32(lanes[0], state_a);
+	vst1q_u32(lanes[1], state_b);
+	vst1q_u32(lanes[2], state_c);
+	vst1q_u32(lanes[3], state_d);
+	for (int i = 0; i < PARA_NUM; i++) {
+		for (int w = 0; w < 4; w++) {
+			state[i * 4 + w] = ByteSwap(lanes[w][i]);
+		}
+	}
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include <iostream>
 #include <string>
 #include <cstring>
@@ -100,6 +101,13 @@ typedef unsigned int bit32;
   (a) += (b); \
 }
 
+// II 的逆运算：已知这一步之后的 a 以及 b, c, d（这一步不改变它们）和消息字 x，反推这一步之前的 a
+// 用于由目标摘要反推 MD5 最后几步之前的中间状态
+#define II_REVERSE(a, b, c, d, x, s, ac) { \
+  (a) = ROTATELEFT((a) - (b), 32 - (s)); \
+  (a) -= I ((b), (c), (d)) + (x) + ac; \
+}
+
 // *SIMD 4-way 版本 >>>
 #define FF_SIMD(a, b, c, d, x, s, ac) { \
   a = vaddq_u32(ROTATELEFT_SIMD(vaddq_u32(vaddq_u32(a, F_SIMD(b, c, d)), vaddq_u32(x, vdupq_n_u32(ac))), s), b); \
@@ -204,6 +212,30 @@ typedef unsigned int bit32;
   (a).val[1] = tmp.val[1]; \
 }
 
+// 早退比对的目标：单块（口令长度 <= 55）消息的最后几步中，部分消息字只含填充的 0，
+// 因此可以由目标摘要反推出这几步之前的中间状态，生成时算到那一步即可比对，不必算完 64 步
+// 反推的步数 D 取决于这一批口令的最大长度（对应的消息字须全为 0）：
+//   长度 <= 7：反推第 64~57 步（M9, M2, M11, M4, M13, M6, M15, M8），比对第 53 步写入的 a
+//   长度 <= 35：反推第 64 步（M9），比对第 60 步写入的 b
+//   长度 <= 55：不反推，比对第 61 步写入的 a（第 62~64 步不再改变 a）
+typedef struct {
+    bit32 digest[4];    // 目标摘要（与 MD5Hash 输出的 state 格式相同）
+    bit32 early[3];     // 依次为上述三种情况下用于比对的寄存器值
+} md5Target_t;
+
+// 由目标摘要计算早退比对所需的中间状态
+void MD5ReverseTarget(const bit32 *digest, md5Target_t &target);
+
+// MD5 中间状态：一个固定前缀（如盐值）中完整的 64 字节块只需处理一次，所有以它开头的消息都从这里继续
+typedef struct {
+    bit32 state[4];     // 处理完前缀中所有完整块之后的状态（尚未做大小端转换）
+    long long length;   // 已处理的字节数（64 的倍数）
+    string tail;        // 前缀中不足一块的剩余部分，计算时拼接在每个消息之前
+} md5Midstate_t;
+
+// 计算前缀的中间状态；前缀为空时即为 MD5 的初始状态
+void MD5Midstate(const string &prefix, md5Midstate_t &mid);
+
 // 函数声明
 void MD5Hash(string input, bit32 *state);
 
@@ -211,4 +243,10 @@ void MD5Hash(string input, bit32 *state);
 void SIMDMD5Hash_2(string *input, bit32 *state);
 void SIMDMD5Hash_4(string *input, bit32 *state);
 void SIMDMD5Hash_8basic(string *input, bit32 *state);
-void SIMDMD5Hash_8advanced(string *input, bit32 *state);
\ No newline at end of file
+void SIMDMD5Hash_8advanced(string *input, bit32 *state);
+
+// 从中间状态出发的四路并行 MD5：计算 md5(前缀 + input[i])，各通道的块数可以不同
+void SIMDMD5HashFrom_4(const md5Midstate_t &mid, string *input, bit32 *state);
+
+// 早退破解：四路并行计算 input 的 MD5，只判断是否命中 targets 中的某个目标，返回命中的通道掩码
+int SIMDMD5Crack_4(string *input, const md5Target_t *targets, int n_targets);
\ No newline at end of file
@@ -116,6 +116,19 @@ int model::FindSymbol(segment seg)
     return -1;
 }
 
+segment &model::GetSegment(const PT &pt, int index)
+{
+    if (pt.content[index].type == 1)
+    {
+        return letters[pt.seg_ids[index]];
+    }
+    if (pt.content[index].type == 2)
+    {
+        return digits[pt.seg_ids[index]];
+    }
+    return symbols[pt.seg_ids[index]];
+}
+
 void PT::insert(segment seg)
 {
     content.emplace_back(seg);
@@ -154,11 +167,27 @@ void segment::order()
         ordered_freqs.emplace_back(freqs.at(values[val]));
         total_freq += freqs.at(values[val]);
     }
-    for (string val : ordered_values)
+
+    // 预计算每个 value 的概率及其对数，PT 概率计算时直接查表
+    ordered_probs.reserve(ordered_freqs.size());
+    ordered_log_probs.reserve(ordered_freqs.size());
+    for (int freq : ordered_freqs)
     {
-        ordered_freqs.emplace_back(freqs.at(values[val]));
-        total_freq += freqs.at(values[val]);
+        ordered_probs.emplace_back(float(freq) / total_freq);
+        ordered_log_probs.emplace_back(log(double(freq) / total_freq));
     }
+
+    // 将频数相同的连续 value 划分为同一个类。长尾部分（例如只出现过一次的大量 L8）会被合并为少数几个类
+    for (size_t i = 0; i < ordered_freqs.size(); i += 1)
+    {
+        if (i == 0 || ordered_freqs[i] != ordered_freqs[i - 1])
+        {
+            class_starts.emplace_back(i);
+            class_probs.emplace_back(ordered_probs[i]);
+            class_log_probs.emplace_back(ordered_log_probs[i]);
+        }
+    }
+    class_starts.emplace_back(ordered_freqs.size());
 }
 
 void model::parse(string pw)
@@ -425,6 +454,28 @@ void PT::PrintPT()
     }
 }
 
+string PT::Pattern() const
+{
+    string pattern;
+    for (const segment &seg : content)
+    {
+        if (seg.type == 1)
+        {
+            pattern += "L";
+        }
+        if (seg.type == 2)
+        {
+            pattern += "D";
+        }
+        if (seg.type == 3)
+        {
+            pattern += "S";
+        }
+        pattern += to_string(seg.length);
+    }
+    return pattern;
+}
+
 void model::print()
 {
     cout << "preterminals:" << endl;
@@ -500,4 +551,361 @@ void model::order()
     {
         symbols[i].order();
     }
+
+    // 生成时从模型镜像中读取 value，单进程时镜像就在本地
+    Pack(image);
+    Attach(image.data(), image.size());
+}
+
+// ============= 模型镜像 ============= //
+// 镜像布局（各部分按 8 字节对齐）：
+// 1. int32 letters / digits / symbols 的 segment 数、PT 数、total_preterm
+// 2. 依次为每个 segment：int32 type, length, value 数 n, value 类数 c；
+//    int32 class_starts[c + 1]；float class_probs[c]；double class_log_probs[c]；
+//    uint32 value_offsets[n + 1]；value 字节
+// 3. 依次为 ordered_pts 中的每个 PT：int32 segment 数 k、该 PT 的频数，然后是 k 对 (type, length)
+
+/**
+ * PutBytes: 向镜像末尾追加数据，并补齐到 8 字节
+ */
+static void PutBytes(vector<char> &image, const void *data, size_t size)
+{
+    image.insert(image.end(), (const char *)data, (const char *)data + size);
+    image.resize((image.size() + 7) & ~(size_t)7);
+}
+
+/**
+ * TakeBytes: 从镜像中读取一段数据的起始地址，并跳过补齐
+ * @param image_size 镜像的字节数
+ * @param size 数据的字节数
+ * @return 数据的起始地址；镜像中剩余的字节不足 size 时（镜像不完整或已损坏）返回 NULL
+ */
+static const char *TakeBytes(const char *&cursor, const char *image, size_t image_size, size_t size)
+{
+    size_t offset = cursor - image;
+    if (offset > image_size || size > image_size - offset)
+    {
+        return NULL;
+    }
+    const char *data = cursor;
+    offset = (offset + size + 7) & ~(size_t)7;
+    cursor = image + min(offset, image_size);
+    return data;
+}
+
+/**
+ * Pack: 将生成所需的数据序列化为模型镜像
+ * @param[out] image 模型镜像
+ */
+void model::Pack(vector<char> &image) const
+{
+    image.clear();
+    int header[5] = {(int)letters.size(), (int)digits.size(), (int)symbols.size(), (int)ordered_pts.size(), total_preterm};
+    PutBytes(image, header, sizeof(header));
+
+    const vector<segment> *groups[3] = {&letters, &digits, &symbols};
+    for (const vector<segment> *group : groups)
+    {
+        for (const segment &seg : *group)
+        {
+            int n = seg.ordered_values.size();
+            int c = seg.class_probs.size();
+            int info[4] = {seg.type, seg.length, n, c};
+            PutBytes(image, info, sizeof(info));
+            PutBytes(image, seg.class_starts.data(), (c + 1) * sizeof(int));
+            PutBytes(image, seg.class_probs.data(), c * sizeof(float));
+            PutBytes(image, seg.class_log_probs.data(), c * sizeof(double));
+
+            vector<uint32_t> offsets(n + 1, 0);
+            string bytes;
+            for (int i = 0; i < n; i += 1)
+            {
+                bytes += seg.ordered_values[i];
+                offsets[i + 1] = bytes.size();
+            }
+            PutBytes(image, offsets.data(), (n + 1) * sizeof(uint32_t));
+            PutBytes(image, bytes.data(), bytes.size());
+        }
+    }
+
+    for (const PT &pt : ordered_pts)
+    {
+        // order() 之后 preterminals 不再变化，这里的 const_cast 只是因为 FindPT 没有声明为 const
+        int id = const_cast<model *>(this)->FindPT(pt);
+        int info[2] = {(int)pt.content.size(), preterm_freq.at(id)};
+        PutBytes(image, info, sizeof(info));
+        vector<int> content;
+        for (const segment &seg : pt.content)
+        {
+            content.push_back(seg.type);
+            content.push_back(seg.length);
+        }
+        PutBytes(image, content.data(), content.size() * sizeof(int));
+    }
+}
+
+/**
+ * Attach: 使模型指向一个模型镜像
+ * 已训练的模型：segment 已经存在，只更新 value 类并把 value 表指向镜像；
+ * 未训练的模型（共享模式下的其他进程）：按镜像新建 segment 和 PT 表
+ * 每次读取都检查不超出 size，各部分的计数和下标也逐一检查，镜像不完整或已损坏时返回 false（模型此时不可用）
+ * @param image 模型镜像，在模型使用期间必须保持有效
+ * @param size 镜像的字节数
+ * @return 镜像是否完整有效
+ */
+bool model::Attach(const char *image, size_t size)
+{
+    attached = image;
+    attached_size = size;
+    const char *cursor = image;
+    const int *header = (const int *)TakeBytes(cursor, image, size, 5 * sizeof(int));
+    if (header == NULL || header[0] < 0 || header[1] < 0 || header[2] < 0 || header[3] < 0 || header[4] <= 0)
+    {
+        return false;
+    }
+    bool rebuild = ordered_pts.empty();
+
+    vector<segment> *groups[3] = {&letters, &digits, &symbols};
+    for (int g = 0; g < 3; g += 1)
+    {
+        if (rebuild)
+        {
+            groups[g]->clear();
+        }
+        else if (header[g] != (int)groups[g]->size())
+        {
+            return false;
+        }
+        for (int i = 0; i < header[g]; i += 1)
+        {
+            const int *info = (const int *)TakeBytes(cursor, image, size, 4 * sizeof(int));
+            if (info == NULL || info[2] < 0 || info[3] < 0)
+            {
+                return false;
+            }
+            int n = info[2], c = info[3];
+
+            const int *starts = (const int *)TakeBytes(cursor, image, size, ((size_t)c + 1) * sizeof(int));
+            const float *probs = (const float *)TakeBytes(cursor, image, size, (size_t)c * sizeof(float));
+            const double *log_probs = (const double *)TakeBytes(cursor, image, size, (size_t)c * sizeof(double));
+            const uint32_t *offsets = (const uint32_t *)TakeBytes(cursor, image, size, ((size_t)n + 1) * sizeof(uint32_t));
+            if (starts == NULL || probs == NULL || log_probs == NULL || offsets == NULL)
+            {
+                return false;
+            }
+            // value 类从第 0 个 value 开始、依次相接并恰好覆盖全部 n 个 value；value 的字节区间同样依次相接
+            if (starts[0] != 0 || starts[c] != n || offsets[0] != 0)
+            {
+                return false;
+            }
+            for (int k = 0; k < c; k += 1)
+            {
+                if (starts[k] > starts[k + 1])
+                {
+                    return false;
+                }
+            }
+            for (int k = 0; k < n; k += 1)
+            {
+                if (offsets[k] > offsets[k + 1])
+                {
+                    return false;
+                }
+            }
+            const char *bytes = TakeBytes(cursor, image, size, offsets[n]);
+            if (bytes == NULL)
+            {
+                return false;
+            }
+
+            if (rebuild)
+            {
+                groups[g]->emplace_back(info[0], info[1]);
+            }
+            segment &seg = (*groups[g])[i];
+            seg.class_starts.assign(starts, starts + c + 1);
+            seg.class_probs.assign(probs, probs + c);
+            seg.class_log_probs.assign(log_probs, log_probs + c);
+
+            seg.value_count = n;
+            seg.value_offsets = offsets;
+            seg.value_bytes = bytes;
+        }
+    }
+
+    for (int p = 0; p < header[3]; p += 1)
+    {
+        const int *info = (const int *)TakeBytes(cursor, image, size, 2 * sizeof(int));
+        if (info == NULL || info[0] <= 0 || info[1] < 0)
+        {
+            return false;
+        }
+        const int *content = (const int *)TakeBytes(cursor, image, size, 2 * (size_t)info[0] * sizeof(int));
+        if (content == NULL)
+        {
+            return false;
+        }
+        if (!rebuild)
+        {
+            continue;
+        }
+        PT pt;
+        for (int k = 0; k < info[0]; k += 1)
+        {
+            // PT 的每个 segment 都必须在镜像的 segment 表中（生成时按 seg_ids 直接定位）
+            segment seg(content[2 * k], content[2 * k + 1]);
+            int id = -1;
+            if (seg.type == 1)
+            {
+                id = FindLetter(seg);
+            }
+            else if (seg.type == 2)
+            {
+                id = FindDigit(seg);
+            }
+            else if (seg.type == 3)
+            {
+                id = FindSymbol(seg);
+            }
+            if (id == -1)
+            {
+                return false;
+            }
+            pt.insert(seg);
+            // 与 parse 中一致：初始 PT 的每个 segment 都从第 0 类开始
+            pt.curr_indices.emplace_back(0);
+        }
+        pt.preterm_prob = float(info[1]) / header[4];
+        // 镜像中的 PT 表即为 preterminals，FindPT 返回的下标与 preterm_freq 对应
+        preterm_freq[preterminals.size()] = info[1];
+        preterminals.emplace_back(pt);
+        ordered_pts.emplace_back(pt);
+    }
+    if (rebuild)
+    {
+        total_preterm = header[4];
+    }
+    return true;
+}
+
+/**
+ * SaveImage: 将当前使用的模型镜像写入文件
+ * @param path 文件路径
+ * @return 是否成功
+ */
+bool model::SaveImage(string path) const
+{
+    if (attached == NULL)
+    {
+        return false;
+    }
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(attached, attached_size);
+    return out.good();
+}
+
+/**
+ * LoadImage: 从文件读入模型镜像并 Attach，代替 train + order
+ * @param path SaveImage 写出的文件
+ * @return 是否成功
+ */
+bool model::LoadImage(string path)
+{
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in)
+    {
+        return false;
+    }
+    size_t size = in.tellg();
+    in.seekg(0);
+    image.resize(size);
+    in.read(image.data(), size);
+    if (!in || size < 5 * sizeof(int) || !Attach(image.data(), size))
+    {
+        vector<char>().swap(image);
+        attached = NULL;
+        attached_size = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * ReleaseTrainingData: 释放只在训练中使用的数据，生成只需要 value 类和镜像中的 value 表
+ */
+void model::ReleaseTrainingData()
+{
+    vector<segment> *groups[3] = {&letters, &digits, &symbols};
+    for (vector<segment> *group : groups)
+    {
+        for (segment &seg : *group)
+        {
+            unordered_map<string, int>().swap(seg.values);
+            unordered_map<int, int>().swap(seg.freqs);
+            vector<string>().swap(seg.ordered_values);
+            vector<int>().swap(seg.ordered_freqs);
+            vector<float>().swap(seg.ordered_probs);
+            vector<double>().swap(seg.ordered_log_probs);
+        }
+    }
+    unordered_map<int, int>().swap(letters_freq);
+    unordered_map<int, int>().swap(digits_freq);
+    unordered_map<int, int>().swap(symbols_freq);
+}
+
+/**
+ * TrainShared: 节点内共享模型
+ * 1. 按 MPI_COMM_TYPE_SHARED 划分出节点内的通信域，节点内 0 号进程训练模型并生成镜像
+ * 2. 在节点内用 MPI_Win_allocate_shared 分配窗口（只有 0 号进程提供内存），0 号进程写入镜像
+ * 3. 节点内所有进程 Attach 到窗口中的镜像，各自只保留 value 类和 PT 表这些小数据
+ * @param train_path 训练集路径
+ */
+void model::TrainShared(string train_path)
+{
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    int node_rank;
+    MPI_Comm_rank(node_comm, &node_rank);
+
+    unsigned long long size = 0;
+    if (node_rank == 0)
+    {
+        train(train_path);
+        order();
+        size = image.size();
+    }
+    MPI_Bcast(&size, 1, MPI_UNSIGNED_LONG_LONG, 0, node_comm);
+
+    char *base = NULL;
+    MPI_Win_allocate_shared(node_rank == 0 ? size : 0, 1, MPI_INFO_NULL, node_comm, &base, &shared_win);
+    if (node_rank != 0)
+    {
+        MPI_Aint segment_size;
+        int disp_unit;
+        MPI_Win_shared_query(shared_win, 0, &segment_size, &disp_unit, &base);
+    }
+
+    MPI_Win_fence(0, shared_win);
+    if (node_rank == 0)
+    {
+        memcpy(base, image.data(), size);
+    }
+    // 第二次 fence 之后 0 号进程写入的镜像对节点内所有进程可见
+    MPI_Win_fence(0, shared_win);
+
+    Attach(base, size);
+    ReleaseTrainingData();
+    vector<char>().swap(image);
+    MPI_Comm_free(&node_comm);
+}
+
+/**
+ * ReleaseShared: 释放共享窗口
+ */
+void model::ReleaseShared()
+{
+    if (shared_win != MPI_WIN_NULL)
+    {
+        MPI_Win_free(&shared_win);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "writer.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/uio.h>
+
+using namespace std;
+
+/**
+ * HexEncode: 将 MD5 摘要编码为 32 个小写十六进制字符
+ * state 中每个 bit32 按 setw(8) hex 输出，即按大端字节序输出，所以先用 vrev32q_u8 翻转每个字内的字节，
+ * 再分别取出高、低 4 位，通过 vqtbl1q_u8 查表得到字符，最后用 vzip 交错为 "高 低 高 低 ..." 的顺序
+ * @param digest 摘要
+ * @param[out] out 32 个字符（不追加 '\0'）
+ */
+void HexEncode(const bit32 *digest, char *out)
+{
+    static const uint8_t table[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+    uint8x16_t hex_table = vld1q_u8(table);
+
+    uint8x16_t bytes = vrev32q_u8(vld1q_u8((const uint8_t *)digest));
+    uint8x16_t high = vqtbl1q_u8(hex_table, vshrq_n_u8(bytes, 4));
+    uint8x16_t low = vqtbl1q_u8(hex_table, vandq_u8(bytes, vdupq_n_u8(0x0f)));
+
+    vst1q_u8((uint8_t *)out, vzip1q_u8(high, low));
+    vst1q_u8((uint8_t *)out + 16, vzip2q_u8(high, low));
+}
+
+GuessWriter::~GuessWriter()
+{
+    close();
+}
+
+/**
+ * open: 打开输出文件并启动写线程
+ * @param path 文件路径，"-" 表示标准输出
+ * @param format 输出格式（WriterFormat）
+ * @param with_digest 是否输出摘要
+ * @return 是否成功
+ */
+bool GuessWriter::open(const string &path, int format, bool with_digest)
+{
+    close();
+    fd = (path == "-") ? dup(STDOUT_FILENO) : ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    this->format = format;
+    this->with_digest = with_digest;
+
+    for (int i = 0; i < 2; i++) {
+        buffers[i] = (char *)aligned_alloc(WRITER_ALIGNMENT, WRITER_BUFFER_SIZE);
+    }
+    active = 0;
+    fill = 0;
+    submitted = 0;
+    pending = -1;
+    terminate = false;
+    write_errno = 0;
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+    pthread_create(&thread, NULL, writerThread, this);
+    return true;
+}
+
+/**
+ * writerThread: 写线程，等待生成线程交来的缓冲区并写出
+ * 被信号中断（EINTR）时重试；其他错误记入 write_errno，之后交来的缓冲区不再写出（输出已经不完整）
+ */
+void *GuessWriter::writerThread(void *writer)
+{
+    GuessWriter *w = (GuessWriter *)writer;
+    pthread_mutex_lock(&w->mutex);
+    while (true) {
+        while (w->pending < 0 && !w->terminate) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->pending < 0 && w->terminate) {
+            break;
+        }
+
+        // 写出时不持有锁，生成线程可以同时填充另一个缓冲区
+        char *data = w->buffers[w->pending];
+        size_t size = w->pending_size;
+        int error = w->write_errno;
+        pthread_mutex_unlock(&w->mutex);
+
+        size_t written = 0;
+        while (error == 0 && written < size) {
+            ssize_t ret = ::write(w->fd, data + written, size - written);
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ret <= 0) {
+                // write 返回 0 时没有 errno，按 I/O 错误记录
+                error = (ret < 0) ? errno : EIO;
+                break;
+            }
+            written += ret;
+        }
+
+        pthread_mutex_lock(&w->mutex);
+        w->write_errno = error;
+        w->pending = -1;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return NULL;
+}
+
+/**
+ * submit: 将当前缓冲区交给写线程，切换到另一个缓冲区
+ * 写线程还在写上一个缓冲区时等待其完成
+ */
+void GuessWriter::submit()
+{
+    if (fill == 0) {
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    while (pending >= 0) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    pending = active;
+    pending_size = fill;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+
+    submitted += fill;
+    active ^= 1;
+    fill = 0;
+}
+
+void GuessWriter::reserve(size_t n)
+{
+    if (fill + n > WRITER_BUFFER_SIZE) {
+        submit();
+    }
+}
+
+/**
+ * write: 追加一个口令
+ * @param pw 口令（二进制格式下长度超过 65535 的部分被截断）
+ * @param digest 摘要，with_digest 时使用
+ */
+void GuessWriter::write(const string &pw, const bit32 *digest)
+{
+    size_t length = pw.size();
+    if (format == WRITER_BINARY) {
+        length = min(length, (size_t)0xffff);
+        reserve(2 + length + 16);
+        char *out = buffers[active] + fill;
+        out[0] = length & 0xff;
+        out[1] = (length >> 8) & 0xff;
+        memcpy(out + 2, pw.data(), length);
+        fill += 2 + length;
+        if (with_digest) {
+            // 与十六进制输出的字节顺序相同：每个字按大端存放
+            uint8x16_t bytes = vrev32q_u8(vld1q_u8((const uint8_t *)digest));
+            vst1q_u8((uint8_t *)buffers[active] + fill, bytes);
+            fill += 16;
+        }
+    }
+    else {
+        reserve(length + 34);
+        char *out = buffers[active] + fill;
+        memcpy(out, pw.data(), length);
+        fill += length;
+        if (with_digest) {
+            buffers[active][fill++] = '\t';
+            HexEncode(digest, buffers[active] + fill);
+            fill += 32;
+        }
+        buffers[active][fill++] = '\n';
+    }
+}
+
+/**
+ * write: 追加一批口令（不带摘要）
+ */
+void GuessWriter::write(const vector<string> &guesses)
+{
+    for (const string &pw : guesses) {
+        write(pw, NULL);
+    }
+}
+
+/**
+ * close: 写出剩余数据，等待写线程结束，关闭文件
+ * @return 是否全部写出（包括关闭文件时的错误），失败时 writeError 给出 errno
+ */
+bool GuessWriter::close()
+{
+    if (fd < 0) {
+        return write_errno == 0;
+    }
+    submit();
+
+    pthread_mutex_lock(&mutex);
+    terminate = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+    for (int i = 0; i < 2; i++) {
+        free(buffers[i]);
+        buffers[i] = NULL;
+    }
+    if (::close(fd) != 0 && write_errno == 0) {
+        write_errno = errno;
+    }
+    fd = -1;
+    return write_errno == 0;
+}
+
+/**
+ * StreamGuesses: 用 writev 将 guesses 逐行写到 fd
+ * 每次 writev 提交 STREAM_IOV_GUESSES 个口令及其换行，部分写入时从中断处继续
+ * @param fd 输出的文件描述符（标准输出、FIFO 或普通文件）
+ * @param guesses 要写出的猜测
+ * @return 是否全部写出
+ */
+bool StreamGuesses(int fd, const vector<string> &guesses)
+{
+    static const char newline = '\n';
+    struct iovec iov[2 * STREAM_IOV_GUESSES];
+
+    for (size_t base = 0; base < guesses.size(); base += STREAM_IOV_GUESSES) {
+        int n = min((size_t)STREAM_IOV_GUESSES, guesses.size() - base);
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            iov[count].iov_base = (void *)guesses[base + i].data();
+            iov[count].iov_len = guesses[base + i].size();
+            count++;
+            iov[count].iov_base = (void *)&newline;
+            iov[count].iov_len = 1;
+            count++;
+        }
+
+        struct iovec *current = iov;
+        while (count > 0) {
+            ssize_t ret = writev(fd, current, count);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            // 跳过已经完整写出的 iovec，调整写了一半的那个
+            while (count > 0 && (size_t)ret >= current->iov_len) {
+                ret -= current->iov_len;
+                current++;
+                count--;
+            }
+            if (count > 0) {
+                current->iov_base = (char *)current->iov_base + ret;
+                current->iov_len -= ret;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "md5.h"
+
+using namespace std;
+
+// 输出缓冲区大小（两个缓冲区交替使用），按页对齐
+#define WRITER_BUFFER_SIZE (8 << 20)
+#define WRITER_ALIGNMENT 4096
+
+// 流式输出模式：q.guesses 中累积到这么多个猜测就写出一次（内存中的猜测数因此有上界）
+#define STREAM_BATCH_GUESSES (1 << 16)
+// 一次 writev 写出的猜测数（每个猜测占口令和换行两个 iovec，不超过 IOV_MAX）
+#define STREAM_IOV_GUESSES 512
+
+// 输出格式
+enum WriterFormat {
+    WRITER_TEXT = 0,    // 每行一个口令；带摘要时为 "口令\t十六进制摘要"
+    WRITER_BINARY,      // 每个口令为 2 字节小端长度 + 口令字节；带摘要时其后紧跟 16 字节摘要（与十六进制输出的字节顺序相同）
+};
+
+// 将 MD5 摘要（state 格式的 4 个 bit32）编码为 32 个小写十六进制字符，使用 NEON 查表，一次处理 16 个字节
+void HexEncode(const bit32 *digest, char *out);
+
+// 流式输出：用 writev 将 guesses 逐行直接写到 fd（口令不拷贝到中间缓冲区）
+// fd 为管道 / FIFO 且已满时 writev 阻塞，调用者的生成循环随之暂停，即由消费者的速度决定生成速度
+// 返回是否成功，消费者关闭管道（EPIPE）时返回 false
+bool StreamGuesses(int fd, const vector<string> &guesses);
+
+// 猜测输出流：生成线程把猜测追加到当前缓冲区，缓冲区满时交给写线程，自己继续写另一个缓冲区（双缓冲），
+// 只有写线程还没写完上一个缓冲区时才会等待
+class GuessWriter
+{
+public:
+    ~GuessWriter();
+
+    // 打开输出文件（"-" 表示标准输出），启动写线程
+    bool open(const string &path, int format, bool with_digest);
+
+    // 追加一个口令（with_digest 时需给出摘要）
+    void write(const string &pw, const bit32 *digest = NULL);
+
+    // 追加一批口令（不带摘要）
+    void write(const vector<string> &guesses);
+
+    // 写出剩余数据，结束写线程并关闭文件；返回是否全部写出（失败时原因见 writeError）
+    bool close();
+
+    bool isOpen() const { return fd >= 0; }
+    bool withDigest() const { return with_digest; }
+
+    // 已交给写线程的字节数
+    long long bytes() const { return submitted; }
+
+    // 第一次写出失败时的 errno，0 表示没有失败（close 之后仍然有效，下次 open 时清零）
+    int writeError() const { return write_errno; }
+
+private:
+    // 当前缓冲区剩余空间不足 n 字节时，交给写线程并切换到另一个缓冲区
+    void reserve(size_t n);
+
+    // 将当前缓冲区交给写线程
+    void submit();
+
+    // 写线程函数
+    static void *writerThread(void *writer);
+
+    int fd = -1;
+    int format = WRITER_TEXT;
+    bool with_digest = false;
+
+    char *buffers[2] = {NULL, NULL};
+    int active = 0;             // 生成线程正在填充的缓冲区
+    size_t fill = 0;            // 当前缓冲区已填充的字节数
+    long long submitted = 0;
+
+    // 以下由 mutex 保护
+    int pending = -1;           // 等待写线程写出的缓冲区，-1 表示写线程空闲
+    size_t pending_size = 0;
+    bool terminate = false;
+    int write_errno = 0;        // 写线程记录的第一次失败；失败之后的数据不再写出
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};